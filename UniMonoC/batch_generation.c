@@ -0,0 +1,286 @@
+/*
+ * generazione di molti testi con un solo caricamento del modello
+ * il modello viene letto una volta sola; ogni testo del lotto costa soltanto
+ * l'estrazione delle parole e la scrittura, su un file proprio oppure come
+ * riga di un unico flusso. I testi possono essere generati da più thread che
+ * condividono il modello in sola lettura
+ */
+#include "batch_generation.h"
+#include "text_generation.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BATCH_STREAM_BUFFER (1024 * 1024) // buffer del flusso unico di output
+
+/*
+ * prepara i lavori di un lotto
+ * le parole iniziali vengono assegnate ai testi a rotazione; un elemento vuoto
+ * o "*" fa scegliere la parola iniziale a caso, come senza elenco
+ *
+ * parametri
+ *   model: modello di generazione
+ *   textCount: numero di testi
+ *   wordCount: parole di ciascun testo
+ *   startWords: elenco di parole separate da virgole, può essere NULL
+ *
+ * ritorno
+ *   l'array dei lavori (da liberare con free), NULL se una parola non è nel modello
+ */
+GenerationJob *make_generation_jobs(const GenerationModel *model, size_t textCount, int wordCount,
+                                    const char *startWords) {
+    size_t startCount = 1;
+    for (const char *c = startWords; c && *c; c++) {
+        startCount += *c == ',';
+    }
+
+    uint32_t *starts = malloc(startCount * sizeof(uint32_t));
+    GenerationJob *jobs = malloc((textCount + 1) * sizeof(GenerationJob));
+    if (!starts || !jobs) {
+        fprintf(stderr, "Memory allocation failed for generation jobs\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // traduce ogni parola dell'elenco nel suo id
+    starts[0] = NO_STRING;
+    const char *item = startWords;
+    for (size_t i = 0; startWords && i < startCount; i++) {
+        const char *end = strchr(item, ',');
+        size_t length = end ? (size_t)(end - item) : strlen(item);
+        char *word = strndup(item, length);
+        char *lowerWord = word ? to_lowercase(word) : NULL;
+        if (!lowerWord) {
+            fprintf(stderr, "Memory allocation failed for generation jobs\n");
+            exit(EXIT_FAILURE);
+        }
+
+        starts[i] = NO_STRING;
+        if (length > 0 && strcmp(lowerWord, "*") != 0) {
+            starts[i] = find_model_word(model, lowerWord);
+            if (starts[i] == NO_STRING || model_successor_count(model, starts[i]) == 0) {
+                fprintf(stderr, "La parola inserita non è presenta nel testo: %s\n", lowerWord);
+                free(word);
+                free(lowerWord);
+                free(starts);
+                free(jobs);
+                return NULL;
+            }
+        }
+        free(word);
+        free(lowerWord);
+        item += length + 1;
+    }
+
+    for (size_t i = 0; i < textCount; i++) {
+        jobs[i].start = starts[i % startCount];
+        jobs[i].wordCount = wordCount;
+    }
+    free(starts);
+    return jobs;
+}
+
+/*
+ * controlla se il percorso di output è un modello di nome con un solo %d
+ * ogni altro '%' deve essere raddoppiato, così il percorso può essere usato
+ * come formato senza rischi
+ *
+ * ritorno
+ *   1 se ogni testo va scritto in un file proprio, 0 per un flusso unico
+ */
+int is_output_pattern(const char *output) {
+    int placeholders = 0;
+    for (const char *c = output; *c; c++) {
+        if (*c != '%') {
+            continue;
+        }
+        c++;
+        if (*c == '\0') {
+            return 0;
+        }
+        if (*c == 'd') {
+            placeholders++;
+        } else if (*c != '%') {
+            return 0;
+        }
+    }
+    return placeholders == 1;
+}
+
+// lavoro di un thread di generazione: un intervallo contiguo di testi
+typedef struct BatchWorker {
+    const GenerationModel *model;
+    const GenerationJob *jobs;
+    size_t first;
+    size_t last;
+    const char *pattern;    // modello dei nomi dei file, NULL per il flusso unico
+    FILE *stream;           // destinazione dei testi nel flusso unico
+    char *buffer;           // testi del thread, se scritti in memoria
+    size_t bufferSize;
+    Rng rng;
+    long completed;
+    int failed;
+} BatchWorker;
+
+/*
+ * genera il testo di un lavoro
+ *
+ * ritorno
+ *   1 se il testo ha raggiunto la lunghezza richiesta, 0 altrimenti
+ */
+static int generate_job(const GenerationModel *model, const GenerationJob *job, Rng *rng, FILE *file) {
+    uint32_t start = job->start != NO_STRING ? job->start : select_initial_word(model, rng);
+    if (start == NO_STRING) {
+        return 0;
+    }
+    return generate_text(model, start, job->wordCount, rng, file) == job->wordCount;
+}
+
+/*
+ * genera i testi assegnati a un thread
+ * con un modello di percorso ogni testo va nel proprio file, altrimenti i testi
+ * vengono accodati allo stream del thread, uno per riga
+ */
+static void *run_batch_worker(void *arg) {
+    BatchWorker *worker = arg;
+
+    if (worker->pattern) {
+        size_t pathSize = strlen(worker->pattern) + 32;
+        char *path = malloc(pathSize);
+        if (!path) {
+            fprintf(stderr, "Memory allocation failed for output path\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = worker->first; i < worker->last; i++) {
+            snprintf(path, pathSize, worker->pattern, (int)(i + 1));
+            FILE *file = fopen(path, "w");
+            if (!file) {
+                perror("Failed to open output file");
+                worker->failed = 1;
+                break;
+            }
+            worker->completed += generate_job(worker->model, &worker->jobs[i], &worker->rng, file);
+            if (fclose(file) != 0) {
+                perror("Failed to write output file");
+                worker->failed = 1;
+                break;
+            }
+        }
+        free(path);
+        return NULL;
+    }
+
+    for (size_t i = worker->first; i < worker->last; i++) {
+        worker->completed += generate_job(worker->model, &worker->jobs[i], &worker->rng, worker->stream);
+        fputc('\n', worker->stream); // ogni testo occupa una riga
+    }
+    return NULL;
+}
+
+/*
+ * genera tutti i testi di un lotto, eventualmente su più thread
+ * i testi vengono divisi in intervalli contigui, uno per thread, e ogni thread
+ * estrae con il proprio flusso pseudocasuale ricavato da seed: a parità di seme
+ * e di numero di thread l'output è identico. Se output contiene %d ogni testo
+ * viene scritto in un file proprio, numerato da 1; altrimenti i testi vengono
+ * scritti in un unico file, uno per riga, nell'ordine dei lavori
+ *
+ * parametri
+ *   model: modello di generazione, condiviso in sola lettura
+ *   jobs: lavori da eseguire
+ *   jobCount: numero di lavori
+ *   output: percorso o modello di percorso dei file di output
+ *   threadCount: numero di thread; 0 usa tutti i core disponibili
+ *   seed: seme dei generatori pseudocasuali
+ *
+ * ritorno
+ *   il numero di testi generati per intero, -1 se un file non può essere scritto
+ */
+long generate_batch(const GenerationModel *model, const GenerationJob *jobs, size_t jobCount,
+                    const char *output, int threadCount, uint64_t seed) {
+    if (threadCount <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cores > 0 ? (int)cores : 1;
+    }
+    size_t workerCount = (size_t)threadCount;
+    if (workerCount > jobCount) {
+        workerCount = jobCount > 0 ? jobCount : 1;
+    }
+
+    int pattern = is_output_pattern(output);
+    FILE *file = NULL;
+    if (!pattern) {
+        file = fopen(output, "w");
+        if (!file) {
+            perror("Failed to open output file");
+            return -1;
+        }
+        setvbuf(file, NULL, _IOFBF, BATCH_STREAM_BUFFER); // poche scritture grandi per tutto il lotto
+    }
+
+    BatchWorker *workers = calloc(workerCount, sizeof(BatchWorker));
+    pthread_t *threads = malloc(workerCount * sizeof(pthread_t));
+    Rng *streams = malloc(workerCount * sizeof(Rng));
+    if (!workers || !threads || !streams) {
+        fprintf(stderr, "Memory allocation failed for generation threads\n");
+        exit(EXIT_FAILURE);
+    }
+    rng_split(seed, streams, (unsigned)workerCount);
+
+    for (size_t i = 0; i < workerCount; i++) {
+        BatchWorker *worker = &workers[i];
+        worker->model = model;
+        worker->jobs = jobs;
+        worker->first = jobCount * i / workerCount;
+        worker->last = jobCount * (i + 1) / workerCount;
+        worker->pattern = pattern ? output : NULL;
+        worker->rng = streams[i];
+        if (!pattern) {
+            // con un solo thread si scrive direttamente, altrimenti in memoria e poi in ordine
+            worker->stream = workerCount == 1 ? file : open_memstream(&worker->buffer, &worker->bufferSize);
+            if (!worker->stream) {
+                fprintf(stderr, "Memory allocation failed for generation buffer\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (workerCount == 1) {
+        run_batch_worker(&workers[0]);
+    } else {
+        for (size_t i = 0; i < workerCount; i++) {
+            if (pthread_create(&threads[i], NULL, run_batch_worker, &workers[i]) != 0) {
+                fprintf(stderr, "Failed to create generation thread\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (size_t i = 0; i < workerCount; i++) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    long completed = 0;
+    int failed = 0;
+    for (size_t i = 0; i < workerCount; i++) {
+        BatchWorker *worker = &workers[i];
+        completed += worker->completed;
+        failed |= worker->failed;
+        if (worker->stream && worker->stream != file) {
+            fclose(worker->stream);
+            if (!failed && fwrite(worker->buffer, 1, worker->bufferSize, file) != worker->bufferSize) {
+                failed = 1;
+            }
+            free(worker->buffer);
+        }
+    }
+    if (file && fclose(file) != 0) {
+        perror("Failed to write output file");
+        failed = 1;
+    }
+
+    free(streams);
+    free(threads);
+    free(workers);
+    return failed ? -1 : completed;
+}
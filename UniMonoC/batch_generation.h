@@ -0,0 +1,26 @@
+#ifndef BATCH_GENERATION_H
+#define BATCH_GENERATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "generation_model.h"
+
+// un testo da generare in un lotto
+typedef struct GenerationJob {
+    uint32_t start;     // parola iniziale; NO_STRING per sceglierla a caso
+    int wordCount;      // numero di parole del testo
+} GenerationJob;
+
+// prepara textCount lavori; startWords è un elenco separato da virgole usato a rotazione
+GenerationJob *make_generation_jobs(const GenerationModel *model, size_t textCount, int wordCount,
+                                    const char *startWords);
+
+// indica se il percorso di output contiene un segnaposto %d, cioè un file per testo
+int is_output_pattern(const char *output);
+
+// genera tutti i testi del lotto su threadCount thread (0 = tutti i core) a partire da un seme
+// ritorna il numero di testi generati per intero, -1 in caso di errore
+long generate_batch(const GenerationModel *model, const GenerationJob *jobs, size_t jobCount,
+                    const char *output, int threadCount, uint64_t seed);
+
+#endif // BATCH_GENERATION_H
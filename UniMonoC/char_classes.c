@@ -0,0 +1,190 @@
+/*
+ * classificazione vettoriale dei caratteri per il tokenizzatore
+ * invece di chiamare isalpha/isspace/tolower su ogni byte, il testo viene
+ * classificato a blocchi di 16 o 32 byte per volta: per ogni blocco si ottengono
+ * una maschera delle lettere, una dei delimitatori e la copia in minuscolo.
+ * I byte >= 128 sono segnati come lettere e hanno una maschera a parte: il
+ * tokenizzatore decodifica solo i tratti che li contengono, per separare la
+ * punteggiatura tipografica e convertire in minuscolo le lettere accentate.
+ * La variante viene scelta a runtime in base alla CPU (AVX2, SSE2 o scalare);
+ * tutte seguono le regole della localizzazione "C" usata dal programma
+ */
+#include "char_classes.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHAR_CLASSES_X86
+#include <immintrin.h>
+#endif
+
+typedef void (*ClassifyFunction)(const char *data, size_t size, CharClasses *classes);
+
+/*
+ * classifica i byte uno alla volta
+ * usata sulle CPU senza estensioni vettoriali e per la coda dei blocchi incompleti
+ *
+ * parametri
+ *   data: byte da classificare
+ *   size: numero di byte
+ *   classes: maschere e copia in minuscolo da riempire
+ */
+static void classify_scalar(const char *data, size_t size, CharClasses *classes) {
+    for (size_t block = 0; block * CLASS_BLOCK_SIZE < size; block++) {
+        size_t start = block * CLASS_BLOCK_SIZE;
+        size_t end = size - start < CLASS_BLOCK_SIZE ? size : start + CLASS_BLOCK_SIZE;
+        uint64_t letters = 0;
+        uint64_t delimiters = 0;
+        uint64_t highBytes = 0;
+
+        for (size_t i = start; i < end; i++) {
+            unsigned char c = (unsigned char)data[i];
+            uint64_t bit = (uint64_t)1 << (i - start);
+            int ascii = (unsigned char)((c | 0x20) - 'a') < 26;
+            classes->lowered[i] = (char)(ascii ? c | 0x20 : c);
+            if (c >= 128) {
+                letters |= bit;
+                highBytes |= bit;
+            } else if (ascii) {
+                letters |= bit;
+            } else if (c == ' ' || (unsigned char)(c - '\t') < 5 || c == '\'' || c == '.' || c == '?' || c == '!') {
+                delimiters |= bit;
+            }
+        }
+        classes->letters[block] = letters;
+        classes->delimiters[block] = delimiters;
+        classes->highBytes[block] = highBytes;
+    }
+}
+
+#ifdef CHAR_CLASSES_X86
+/*
+ * classifica 16 byte con SSE2
+ * SSE2 ha solo confronti con segno: x è nell'intervallo [low, low + count)
+ * se x - low + 128, letto con segno, è minore di count - 128
+ */
+__attribute__((target("sse2")))
+static inline void classify_sse2_16(const char *data, char *lowered, uint64_t *letters, uint64_t *delimiters,
+                                    uint64_t *highBytes) {
+    __m128i text = _mm_loadu_si128((const __m128i *)data);
+    __m128i folded = _mm_or_si128(text, _mm_set1_epi8(0x20));
+    __m128i ascii = _mm_cmplt_epi8(_mm_add_epi8(folded, _mm_set1_epi8((char)(128 - 'a'))),
+                                   _mm_set1_epi8((char)(26 - 128)));
+    _mm_storeu_si128((__m128i *)lowered, _mm_or_si128(text, _mm_and_si128(ascii, _mm_set1_epi8(0x20))));
+
+    __m128i space = _mm_or_si128(_mm_cmpeq_epi8(text, _mm_set1_epi8(' ')),
+                                 _mm_cmplt_epi8(_mm_add_epi8(text, _mm_set1_epi8((char)(128 - '\t'))),
+                                                _mm_set1_epi8((char)(5 - 128))));
+    __m128i punctuation = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(text, _mm_set1_epi8('\'')),
+                                                    _mm_cmpeq_epi8(text, _mm_set1_epi8('.'))),
+                                       _mm_or_si128(_mm_cmpeq_epi8(text, _mm_set1_epi8('?')),
+                                                    _mm_cmpeq_epi8(text, _mm_set1_epi8('!'))));
+
+    // il bit di segno del testo segna i byte >= 128, che fanno parte delle parole
+    *highBytes = (uint32_t)_mm_movemask_epi8(text);
+    *letters = (uint32_t)_mm_movemask_epi8(ascii) | *highBytes;
+    *delimiters = (uint32_t)_mm_movemask_epi8(_mm_or_si128(space, punctuation));
+}
+
+__attribute__((target("sse2")))
+static void classify_sse2(const char *data, size_t size, CharClasses *classes) {
+    size_t blocks = size / CLASS_BLOCK_SIZE;
+    for (size_t block = 0; block < blocks; block++) {
+        const char *source = data + block * CLASS_BLOCK_SIZE;
+        char *lowered = classes->lowered + block * CLASS_BLOCK_SIZE;
+        uint64_t letters = 0;
+        uint64_t delimiters = 0;
+        uint64_t highBytes = 0;
+        for (int part = 0; part < CLASS_BLOCK_SIZE; part += 16) {
+            uint64_t partLetters, partDelimiters, partHighBytes;
+            classify_sse2_16(source + part, lowered + part, &partLetters, &partDelimiters, &partHighBytes);
+            letters |= partLetters << part;
+            delimiters |= partDelimiters << part;
+            highBytes |= partHighBytes << part;
+        }
+        classes->letters[block] = letters;
+        classes->delimiters[block] = delimiters;
+        classes->highBytes[block] = highBytes;
+    }
+
+    CharClasses tail = {classes->letters + blocks, classes->delimiters + blocks, classes->highBytes + blocks,
+                        classes->lowered + blocks * CLASS_BLOCK_SIZE};
+    classify_scalar(data + blocks * CLASS_BLOCK_SIZE, size - blocks * CLASS_BLOCK_SIZE, &tail);
+}
+
+/*
+ * classifica 32 byte con AVX2, con gli stessi confronti della variante SSE2
+ */
+__attribute__((target("avx2")))
+static inline void classify_avx2_32(const char *data, char *lowered, uint64_t *letters, uint64_t *delimiters,
+                                    uint64_t *highBytes) {
+    __m256i text = _mm256_loadu_si256((const __m256i *)data);
+    __m256i folded = _mm256_or_si256(text, _mm256_set1_epi8(0x20));
+    __m256i ascii = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(26 - 128)),
+                                      _mm256_add_epi8(folded, _mm256_set1_epi8((char)(128 - 'a'))));
+    _mm256_storeu_si256((__m256i *)lowered,
+                        _mm256_or_si256(text, _mm256_and_si256(ascii, _mm256_set1_epi8(0x20))));
+
+    __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(text, _mm256_set1_epi8(' ')),
+                                    _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(5 - 128)),
+                                                      _mm256_add_epi8(text, _mm256_set1_epi8((char)(128 - '\t')))));
+    __m256i punctuation = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(text, _mm256_set1_epi8('\'')),
+                                                          _mm256_cmpeq_epi8(text, _mm256_set1_epi8('.'))),
+                                          _mm256_or_si256(_mm256_cmpeq_epi8(text, _mm256_set1_epi8('?')),
+                                                          _mm256_cmpeq_epi8(text, _mm256_set1_epi8('!'))));
+
+    *highBytes = (uint32_t)_mm256_movemask_epi8(text);
+    *letters = (uint32_t)_mm256_movemask_epi8(ascii) | *highBytes;
+    *delimiters = (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(space, punctuation));
+}
+
+__attribute__((target("avx2")))
+static void classify_avx2(const char *data, size_t size, CharClasses *classes) {
+    size_t blocks = size / CLASS_BLOCK_SIZE;
+    for (size_t block = 0; block < blocks; block++) {
+        const char *source = data + block * CLASS_BLOCK_SIZE;
+        char *lowered = classes->lowered + block * CLASS_BLOCK_SIZE;
+        uint64_t lowLetters, lowDelimiters, lowHighBytes, highLetters, highDelimiters, highHighBytes;
+        classify_avx2_32(source, lowered, &lowLetters, &lowDelimiters, &lowHighBytes);
+        classify_avx2_32(source + 32, lowered + 32, &highLetters, &highDelimiters, &highHighBytes);
+        classes->letters[block] = lowLetters | highLetters << 32;
+        classes->delimiters[block] = lowDelimiters | highDelimiters << 32;
+        classes->highBytes[block] = lowHighBytes | highHighBytes << 32;
+    }
+
+    CharClasses tail = {classes->letters + blocks, classes->delimiters + blocks, classes->highBytes + blocks,
+                        classes->lowered + blocks * CLASS_BLOCK_SIZE};
+    classify_scalar(data + blocks * CLASS_BLOCK_SIZE, size - blocks * CLASS_BLOCK_SIZE, &tail);
+}
+#endif
+
+/*
+ * sceglie la variante più veloce supportata dalla CPU
+ * __builtin_cpu_supports legge solo un dato già calcolato all'avvio, quindi la
+ * scelta può essere ripetuta a ogni chiamata senza stato condiviso tra thread
+ */
+static ClassifyFunction select_classifier(void) {
+#ifdef CHAR_CLASSES_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return classify_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return classify_sse2;
+    }
+#endif
+    return classify_scalar;
+}
+
+/*
+ * classifica un tratto di testo per il tokenizzatore
+ * ogni blocco di 64 byte riceve una maschera delle lettere (A-Z, a-z e byte >= 128),
+ * una dei delimitatori (spazi, apostrofo e fine frase) e una dei byte >= 128;
+ * i bit oltre size sono zero
+ *
+ * parametri
+ *   data: byte da classificare
+ *   size: numero di byte
+ *   classes: maschere da (size + 63) / 64 elementi e copia in minuscolo da size byte
+ */
+void classify_text(const char *data, size_t size, CharClasses *classes) {
+    select_classifier()(data, size, classes);
+}
+
@@ -0,0 +1,21 @@
+#ifndef CHAR_CLASSES_H
+#define CHAR_CLASSES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLASS_BLOCK_SIZE 64 // byte descritti da ogni maschera
+
+// classi dei byte di un tratto di testo, un bit per byte
+// i byte che non sono né lettere né delimitatori vengono ignorati dal tokenizzatore
+typedef struct CharClasses {
+    uint64_t *letters;      // lettere ASCII e byte >= 128, che il tokenizzatore decodifica
+    uint64_t *delimiters;   // spazi, apostrofo, '.', '?' e '!': chiudono le parole
+    uint64_t *highBytes;    // byte >= 128, cioè parti di caratteri UTF-8 non ASCII
+    char *lowered;          // copia del testo con le lettere ASCII in minuscolo
+} CharClasses;
+
+// classifica size byte; le maschere devono avere spazio per (size + 63) / 64 blocchi
+void classify_text(const char *data, size_t size, CharClasses *classes);
+
+#endif // CHAR_CLASSES_H
@@ -0,0 +1,635 @@
+/*
+ * caricamento veloce del csv delle frequenze
+ * il file viene mappato in memoria e scandito senza copiarlo: le righe e i campi
+ * sono trovati con memchr, quindi non c'è limite alla lunghezza di una riga, e
+ * le parole vengono internate direttamente nel costruttore del modello senza
+ * allocare nulla per ogni coppia. Le frequenze scritte da print_word_table
+ * ("1" oppure "0.dddd") sono lette a mano in virgola fissa; gli altri formati
+ * passano da strtod, come faceva atof.
+ * Il file è diviso in tratti che terminano a fine riga, letti in parallelo in
+ * costruttori privati; il vocabolario dei tratti viene poi unito in quello del
+ * primo e le coppie rinumerate, di nuovo in parallelo
+ */
+#include "csv_model.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "utf8.h"
+
+#define CSV_READ_BLOCK_SIZE (1024 * 1024) // blocchi letti quando il file non si può mappare
+#define MIN_CSV_RANGE_SIZE (256 * 1024)    // sotto questa dimensione un thread in più non conviene
+
+// contenuto di un csv in memoria
+typedef struct CsvFile {
+    char *data;
+    size_t size;
+    int mapped;                 // 1 se data è una mappatura, 0 se è stato letto con malloc
+} CsvFile;
+
+// tratto del csv assegnato a un thread
+typedef struct CsvRangeJob {
+    const char *data;
+    size_t size;
+    CsvValues values;
+    ModelBuilder builder;       // coppie del tratto, con un vocabolario privato
+    ModelBuilder *target;       // costruttore finale in cui copiare le coppie
+    uint32_t *remap;            // id privato -> id nel costruttore finale
+    size_t offset;              // posizione della prima coppia nel costruttore finale
+} CsvRangeJob;
+
+// buffer riutilizzato per i campi che vanno copiati prima dell'uso
+typedef struct Scratch {
+    char *data;
+    size_t capacity;
+} Scratch;
+
+/*
+ * copia length byte nel buffer e li termina con '\0'
+ *
+ * parametri
+ *   scratch: buffer da riutilizzare, ingrandito se serve
+ *   text: byte da copiare
+ *   length: numero di byte
+ *
+ * ritorno
+ *   la copia terminata, valida fino alla prossima chiamata
+ */
+static char *scratch_copy(Scratch *scratch, const char *text, size_t length) {
+    if (length + 1 > scratch->capacity) {
+        size_t capacity = scratch->capacity ? scratch->capacity : 64;
+        while (capacity < length + 1) {
+            capacity *= 2;
+        }
+        char *data = realloc(scratch->data, capacity);
+        if (!data) {
+            fprintf(stderr, "Memory allocation failed for CSV field\n");
+            exit(EXIT_FAILURE);
+        }
+        scratch->data = data;
+        scratch->capacity = capacity;
+    }
+    memcpy(scratch->data, text, length);
+    scratch->data[length] = '\0';
+    return scratch->data;
+}
+
+/*
+ * converte una frequenza del csv in un peso intero in decimillesimi
+ * il formato scritto dal programma è "1" oppure "0." seguito da quattro cifre,
+ * quindi il peso è esattamente l'intero scritto; qualsiasi altro testo passa da
+ * strtod e viene arrotondato al decimillesimo più vicino. Una frequenza positiva
+ * pesa almeno 1, così nessun successore valido diventa impossibile da estrarre
+ *
+ * parametri
+ *   field: caratteri del campo, non terminati
+ *   length: lunghezza del campo
+ *   scratch: buffer per la copia richiesta da strtod
+ *   weight: riceve il peso
+ *
+ * ritorno
+ *   1 se la frequenza è positiva, 0 altrimenti
+ */
+static int parse_frequency(const char *field, size_t length, Scratch *scratch, uint32_t *weight) {
+    if (length == 1 && field[0] == '1') {
+        *weight = CSV_FREQUENCY_SCALE;
+        return 1;
+    }
+    if (length == 6 && field[0] == '0' && field[1] == '.') {
+        uint32_t value = 0;
+        size_t i = 2;
+        while (i < length && (unsigned char)(field[i] - '0') < 10) {
+            value = value * 10 + (uint32_t)(field[i] - '0');
+            i++;
+        }
+        if (i == length) {
+            *weight = value;
+            return value > 0;
+        }
+    }
+
+    double frequency = strtod(scratch_copy(scratch, field, length), NULL);
+    if (!(frequency > 0)) {
+        return 0;
+    }
+    double scaled = frequency * CSV_FREQUENCY_SCALE + 0.5;
+    *weight = scaled >= UINT32_MAX ? UINT32_MAX : scaled < 1 ? 1 : (uint32_t)scaled;
+    return 1;
+}
+
+/*
+ * legge un conteggio del csv dei conteggi esatti
+ * sono accettate solo cifre decimali, con un valore tra 1 e 2^32 - 1
+ *
+ * parametri
+ *   field: caratteri del campo, non terminati
+ *   length: lunghezza del campo
+ *   weight: riceve il conteggio
+ *
+ * ritorno
+ *   1 se il conteggio è valido, 0 altrimenti
+ */
+static int parse_count(const char *field, size_t length, uint32_t *weight) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned digit = (unsigned char)(field[i] - '0');
+        if (digit >= 10) {
+            return 0;
+        }
+        value = value * 10 + digit;
+        if (value > UINT32_MAX) {
+            return 0;
+        }
+    }
+    *weight = (uint32_t)value;
+    return value > 0;
+}
+
+/*
+ * cerca il prossimo campo non vuoto della riga
+ * le virgole consecutive vengono saltate come faceva strtok
+ *
+ * parametri
+ *   cursor: posizione corrente, aggiornata dopo il campo
+ *   end: fine della riga
+ *   length: lunghezza del campo trovato
+ *
+ * ritorno
+ *   l'inizio del campo oppure NULL se la riga è finita
+ */
+static const char *next_field(const char **cursor, const char *end, size_t *length) {
+    const char *start = *cursor;
+    while (start < end && *start == ',') {
+        start++;
+    }
+    if (start == end) {
+        *cursor = end;
+        return NULL;
+    }
+    const char *comma = memchr(start, ',', (size_t)(end - start));
+    const char *fieldEnd = comma ? comma : end;
+    *length = (size_t)(fieldEnd - start);
+    *cursor = fieldEnd;
+    return start;
+}
+
+/*
+ * aggiunge al costruttore le coppie di una riga
+ * la riga ha la forma parola,successiva,valore,successiva,valore,...;
+ * la parola corrente viene convertita in minuscolo e internata solo alla prima
+ * coppia valida
+ */
+static void parse_csv_row(const char *line, const char *end, CsvValues values, ModelBuilder *builder,
+                          Scratch *scratch) {
+    const char *cursor = line;
+    size_t wordLength;
+    const char *word = next_field(&cursor, end, &wordLength);
+    if (!word) {
+        return;
+    }
+
+    uint32_t wordId = NO_STRING;
+    for (;;) {
+        size_t nextLength, valueLength;
+        const char *nextWord = next_field(&cursor, end, &nextLength);
+        if (!nextWord) break;
+        const char *valueField = next_field(&cursor, end, &valueLength);
+        if (!valueField) break;
+
+        uint32_t weight;
+        int valid = values == CSV_COUNTS ? parse_count(valueField, valueLength, &weight)
+                                         : parse_frequency(valueField, valueLength, scratch, &weight);
+        if (valid) {
+            if (wordId == NO_STRING) {
+                char *lowerWord = scratch_copy(scratch, word, wordLength);
+                utf8_fold(lowerWord, wordLength);
+                wordId = intern_string_length(&builder->words, lowerWord, wordLength);
+            }
+            uint32_t nextId = intern_string_length(&builder->words, nextWord, nextLength);
+            model_builder_add_ids(builder, wordId, nextId, weight);
+        } else {
+            fprintf(stderr, "Invalid %s '%.*s' for words '%.*s, %.*s'\n",
+                    values == CSV_COUNTS ? "count" : "frequency", (int)valueLength, valueField,
+                    (int)wordLength, word, (int)nextLength, nextWord);
+        }
+    }
+}
+
+/*
+ * aggiunge al costruttore le coppie delle righe di un tratto di csv
+ * il tratto deve iniziare all'inizio di una riga; l'eventuale '\r' finale delle
+ * righe viene ignorato
+ *
+ * parametri
+ *   data: testo del csv, non necessariamente terminato
+ *   size: numero di byte
+ *   values: significato del terzo campo di ogni coppia
+ *   builder: costruttore del modello
+ */
+void parse_csv_rows(const char *data, size_t size, CsvValues values, ModelBuilder *builder) {
+    Scratch scratch = {NULL, 0};
+    const char *end = data + size;
+    const char *line = data;
+    while (line < end) {
+        const char *newline = memchr(line, '\n', (size_t)(end - line));
+        const char *lineEnd = newline ? newline : end;
+        const char *fieldsEnd = lineEnd > line && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+        parse_csv_row(line, fieldsEnd, values, builder, &scratch);
+        line = newline ? newline + 1 : end;
+    }
+    free(scratch.data);
+}
+
+/*
+ * legge tutto il file quando non può essere mappato (pipe, fifo)
+ *
+ * ritorno
+ *   il contenuto allocato con malloc, NULL in caso di errore di lettura
+ */
+static char *read_whole_file(int fd, size_t *size) {
+    size_t capacity = CSV_READ_BLOCK_SIZE;
+    size_t used = 0;
+    char *data = malloc(capacity);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed for CSV buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    for (;;) {
+        if (used == capacity) {
+            capacity *= 2;
+            char *grown = realloc(data, capacity);
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed for CSV buffer\n");
+                exit(EXIT_FAILURE);
+            }
+            data = grown;
+        }
+        ssize_t count = read(fd, data + used, capacity - used);
+        if (count < 0) {
+            perror("Failed to read CSV file");
+            free(data);
+            return NULL;
+        }
+        if (count == 0) {
+            break;
+        }
+        used += (size_t)count;
+    }
+    *size = used;
+    return data;
+}
+
+/*
+ * thread di lettura: aggiunge le righe del tratto al costruttore privato
+ */
+static void *parse_csv_range(void *arg) {
+    CsvRangeJob *job = arg;
+    init_model_builder(&job->builder);
+    parse_csv_rows(job->data, job->size, job->values, &job->builder);
+    return NULL;
+}
+
+/*
+ * thread di unione: copia le coppie del tratto nel costruttore finale con gli id rinumerati
+ * ogni tratto scrive in posizioni sue, quindi i thread non si sovrappongono
+ */
+static void *copy_csv_range(void *arg) {
+    CsvRangeJob *job = arg;
+    ModelBuilder *target = job->target;
+    for (size_t i = 0; i < job->builder.count; i++) {
+        target->from[job->offset + i] = job->remap[job->builder.from[i]];
+        target->to[job->offset + i] = job->remap[job->builder.to[i]];
+        target->weight[job->offset + i] = job->builder.weight[i];
+    }
+    free(job->remap);
+    free_model_builder(&job->builder);
+    return NULL;
+}
+
+/*
+ * legge il csv con più thread e unisce i risultati nel costruttore del primo tratto
+ * le parole dei tratti successivi vengono internate nell'ordine dei tratti e le
+ * coppie restano nell'ordine del file: il modello è lo stesso della lettura
+ * sequenziale
+ *
+ * parametri
+ *   data: righe del csv, senza intestazione
+ *   size: numero di byte
+ *   values: significato del terzo campo di ogni coppia
+ *   threadCount: numero di thread, 0 per usare tutti i core
+ *   model: modello da costruire
+ */
+static void build_csv_model(const char *data, size_t size, CsvValues values, int threadCount,
+                            GenerationModel *model) {
+    if (threadCount <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cores > 0 ? (int)cores : 1;
+    }
+    size_t rangeCount = (size_t)threadCount;
+    if (rangeCount > size / MIN_CSV_RANGE_SIZE) {
+        rangeCount = size / MIN_CSV_RANGE_SIZE;
+    }
+    if (rangeCount == 0) {
+        rangeCount = 1;
+    }
+
+    CsvRangeJob *jobs = calloc(rangeCount, sizeof(CsvRangeJob));
+    pthread_t *threads = malloc(rangeCount * sizeof(pthread_t));
+    if (!jobs || !threads) {
+        fprintf(stderr, "Memory allocation failed for CSV threads\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // divide il file in tratti che iniziano subito dopo un '\n'
+    size_t start = 0;
+    for (size_t i = 0; i < rangeCount; i++) {
+        size_t end = (i == rangeCount - 1) ? size : size / rangeCount * (i + 1);
+        if (end < start) {
+            end = start;
+        }
+        if (end < size && end > start) {
+            const char *newline = memchr(data + end - 1, '\n', size - end + 1);
+            end = newline ? (size_t)(newline - data) + 1 : size;
+        }
+        jobs[i].data = data + start;
+        jobs[i].size = end - start;
+        jobs[i].values = values;
+        start = end;
+    }
+
+    for (size_t i = 0; i < rangeCount; i++) {
+        if (pthread_create(&threads[i], NULL, parse_csv_range, &jobs[i]) != 0) {
+            fprintf(stderr, "Failed to create CSV thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < rangeCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    // il primo tratto fa da costruttore finale: i suoi id restano invariati
+    ModelBuilder *target = &jobs[0].builder;
+    size_t total = target->count;
+    for (size_t i = 1; i < rangeCount; i++) {
+        const StringPool *words = &jobs[i].builder.words;
+        jobs[i].target = target;
+        jobs[i].offset = total;
+        jobs[i].remap = malloc((words->count + 1) * sizeof(uint32_t));
+        if (!jobs[i].remap) {
+            fprintf(stderr, "Memory allocation failed for CSV threads\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t id = 0; id < words->count; id++) {
+            jobs[i].remap[id] = intern_string(&target->words, pool_string(words, id));
+        }
+        total += jobs[i].builder.count;
+    }
+    model_builder_reserve(target, total);
+
+    for (size_t i = 1; i < rangeCount; i++) {
+        if (pthread_create(&threads[i], NULL, copy_csv_range, &jobs[i]) != 0) {
+            fprintf(stderr, "Failed to create CSV thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 1; i < rangeCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    target->count = total;
+
+    finish_model_builder(target, model);
+    free(threads);
+    free(jobs);
+}
+
+/*
+ * copia un campo dell'intestazione; un campo vuoto diventa NULL
+ */
+static char *copy_header_field(const char *start, const char *end) {
+    if (start == end) {
+        return NULL;
+    }
+    char *field = strndup(start, (size_t)(end - start));
+    if (!field) {
+        fprintf(stderr, "Memory allocation failed for CSV header\n");
+        exit(EXIT_FAILURE);
+    }
+    return field;
+}
+
+/*
+ * legge prima e ultima parola dall'intestazione del csv dei conteggi
+ * a differenza delle righe i campi sono posizionali: un campo vuoto indica che
+ * la parola non esiste (testo vuoto o fatto di sola punteggiatura)
+ *
+ * parametri
+ *   fields: caratteri dopo "#counts,"
+ *   end: fine della riga di intestazione
+ *   firstWord, lastWord: ricevono le parole, da liberare con free
+ */
+static void parse_counts_header(const char *fields, const char *end, char **firstWord, char **lastWord) {
+    while (end > fields && (end[-1] == '\n' || end[-1] == '\r')) {
+        end--;
+    }
+    const char *comma = memchr(fields, ',', (size_t)(end - fields));
+    const char *firstEnd = comma ? comma : end;
+    *firstWord = copy_header_field(fields, firstEnd);
+    *lastWord = comma ? copy_header_field(comma + 1, end) : NULL;
+}
+
+/*
+ * rende disponibile in memoria tutto il contenuto del csv
+ * un file regolare viene mappato in sola lettura, gli altri vengono letti per intero
+ *
+ * ritorno
+ *   1 se il contenuto è disponibile, 0 se il file non può essere letto
+ */
+static int open_csv_file(const char *path, CsvFile *csv) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Unable to open the CSV file: %s\n", path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return 0;
+    }
+
+    csv->size = (size_t)st.st_size;
+    csv->data = NULL;
+    csv->mapped = S_ISREG(st.st_mode) && csv->size > 0;
+    if (csv->mapped) {
+        csv->data = mmap(NULL, csv->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (csv->data == MAP_FAILED) {
+            perror("Failed to map CSV file");
+            close(fd);
+            return 0;
+        }
+        madvise(csv->data, csv->size, MADV_WILLNEED);
+    } else if (!S_ISREG(st.st_mode)) {
+        csv->data = read_whole_file(fd, &csv->size);
+        if (!csv->data) {
+            close(fd);
+            return 0;
+        }
+    }
+    close(fd);
+    return 1;
+}
+
+/*
+ * libera il contenuto letto da open_csv_file
+ */
+static void close_csv_file(CsvFile *csv) {
+    if (csv->mapped) {
+        munmap(csv->data, csv->size);
+    } else {
+        free(csv->data);
+    }
+}
+
+/*
+ * riconosce l'intestazione "#counts,<prima>,<ultima>" del csv dei conteggi
+ *
+ * parametri
+ *   csv: contenuto del file
+ *   firstWord, lastWord: ricevono le parole dell'intestazione, da liberare con free
+ *
+ * ritorno
+ *   la posizione della prima riga dopo l'intestazione, 0 se il csv è di frequenze
+ */
+static size_t read_counts_header(const CsvFile *csv, char **firstWord, char **lastWord) {
+    size_t headerLength = strlen(COUNTS_HEADER);
+    *firstWord = NULL;
+    *lastWord = NULL;
+    if (csv->size <= headerLength || memcmp(csv->data, COUNTS_HEADER, headerLength) != 0
+        || csv->data[headerLength] != ',') {
+        return 0;
+    }
+    const char *newline = memchr(csv->data, '\n', csv->size);
+    size_t rowsStart = newline ? (size_t)(newline - csv->data) + 1 : csv->size;
+    parse_counts_header(csv->data + headerLength + 1, csv->data + rowsStart, firstWord, lastWord);
+    return rowsStart;
+}
+
+/*
+ * carica un modello dal csv delle frequenze o da quello dei conteggi esatti
+ * le coppie entrano nel costruttore nell'ordine del file. Le frequenze
+ * diventano pesi in decimillesimi, i conteggi sono usati così come sono
+ *
+ * parametri
+ *   path: percorso del csv
+ *   threadCount: numero di thread di lettura, 0 per usare tutti i core
+ *   model: modello da costruire
+ *
+ * ritorno
+ *   1 se il modello è stato caricato, 0 se il file non può essere letto
+ */
+int load_csv_model(const char *path, int threadCount, GenerationModel *model) {
+    CsvFile csv;
+    if (!open_csv_file(path, &csv)) {
+        return 0;
+    }
+
+    char *firstWord;
+    char *lastWord;
+    size_t rowsStart = read_counts_header(&csv, &firstWord, &lastWord);
+    CsvValues values = rowsStart > 0 ? CSV_COUNTS : CSV_FREQUENCIES;
+
+    build_csv_model(csv.data + rowsStart, csv.size - rowsStart, values, threadCount, model);
+    if (firstWord) {
+        model->firstWord = find_model_word(model, firstWord);
+    }
+    if (lastWord) {
+        model->lastWord = find_model_word(model, lastWord);
+    }
+    free(firstWord);
+    free(lastWord);
+    close_csv_file(&csv);
+    return 1;
+}
+
+/*
+ * carica il csv dei conteggi esatti in una tabella delle parole
+ * serve ad aggiornare un modello: la tabella torna quella dell'analisi che ha
+ * scritto il csv, tranne la coppia (ultimo token, prima parola) che chiudeva il
+ * vecchio testo, tolta perché il testo ora prosegue
+ *
+ * parametri
+ *   path: percorso del csv dei conteggi
+ *   table: tabella inizializzata da popolare
+ *   firstWord, lastWord: ricevono prima parola e ultimo token del vecchio testo,
+ *                        NULL se mancano; da liberare con free
+ *
+ * ritorno
+ *   1 se la tabella è stata caricata, 0 se il file non può essere letto o non
+ *   contiene conteggi
+ */
+int load_counts_table(const char *path, WordTable *table, char **firstWord, char **lastWord) {
+    CsvFile csv;
+    if (!open_csv_file(path, &csv)) {
+        return 0;
+    }
+    size_t rowsStart = read_counts_header(&csv, firstWord, lastWord);
+    if (rowsStart == 0) {
+        fprintf(stderr, "Not a counts model: %s\n", path);
+        close_csv_file(&csv);
+        return 0;
+    }
+
+    Scratch wordScratch = {NULL, 0};
+    Scratch nextScratch = {NULL, 0};
+    int wrapPending = *firstWord && *lastWord;
+    const char *end = csv.data + csv.size;
+    const char *line = csv.data + rowsStart;
+    while (line < end) {
+        const char *newline = memchr(line, '\n', (size_t)(end - line));
+        const char *lineEnd = newline ? newline : end;
+        const char *fieldsEnd = lineEnd > line && lineEnd[-1] == '\r' ? lineEnd - 1 : lineEnd;
+        const char *cursor = line;
+        line = newline ? newline + 1 : end;
+
+        size_t wordLength;
+        const char *word = next_field(&cursor, fieldsEnd, &wordLength);
+        if (!word) continue;
+        char *lowerWord = scratch_copy(&wordScratch, word, wordLength);
+        utf8_fold(lowerWord, wordLength);
+        uint32_t wordId = NO_STRING;
+        int wrapRow = wrapPending && strcmp(lowerWord, *lastWord) == 0;
+
+        for (;;) {
+            size_t nextLength, countLength;
+            const char *nextWord = next_field(&cursor, fieldsEnd, &nextLength);
+            if (!nextWord) break;
+            const char *countField = next_field(&cursor, fieldsEnd, &countLength);
+            if (!countField) break;
+
+            uint32_t count;
+            if (!parse_count(countField, countLength, &count)) {
+                fprintf(stderr, "Invalid count '%.*s' for words '%.*s, %.*s'\n", (int)countLength, countField,
+                        (int)wordLength, word, (int)nextLength, nextWord);
+                continue;
+            }
+            char *next = scratch_copy(&nextScratch, nextWord, nextLength);
+            if (wrapRow && strcmp(next, *firstWord) == 0) {
+                // coppia aggiunta alla fine del vecchio testo: il testo ora prosegue
+                wrapRow = 0;
+                wrapPending = 0;
+                if (--count == 0) continue;
+            }
+            if (wordId == NO_STRING) {
+                wordId = word_table_intern(table, lowerWord);
+            }
+            add_word_ids(table, wordId, word_table_intern(table, next), count);
+        }
+    }
+
+    free(wordScratch.data);
+    free(nextScratch.data);
+    close_csv_file(&csv);
+    return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef CSV_MODEL_H
+#define CSV_MODEL_H
+
+#include <stddef.h>
+#include "generation_model.h"
+#include "text_analysis.h"
+
+#define CSV_FREQUENCY_SCALE 10000 // le frequenze "0.dddd" diventano pesi in decimillesimi
+
+// significato del terzo campo di ogni coppia del csv
+typedef enum CsvValues {
+    CSV_FREQUENCIES,    // frequenze relative scritte da print_word_table
+    CSV_COUNTS          // conteggi esatti scritti da print_word_counts
+} CsvValues;
+
+// aggiunge al costruttore le coppie delle righe csv contenute in size byte
+void parse_csv_rows(const char *data, size_t size, CsvValues values, ModelBuilder *builder);
+
+// carica un modello dal csv delle frequenze o dei conteggi con più thread (0: tutti i core)
+// ritorna 0 se il file non può essere letto
+int load_csv_model(const char *path, int threadCount, GenerationModel *model);
+
+// carica il csv dei conteggi in una tabella, senza la coppia che chiudeva il testo
+// ritorna 0 se il file non può essere letto o non è un csv dei conteggi
+int load_counts_table(const char *path, WordTable *table, char **firstWord, char **lastWord);
+
+#endif // CSV_MODEL_H
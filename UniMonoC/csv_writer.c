@@ -0,0 +1,176 @@
+/*
+ * scrittura veloce del csv del modello
+ * le righe vengono composte in un buffer grande di proprietà del writer: le
+ * parole internate sono copiate con memcpy e le frequenze formattate a mano in
+ * virgola fissa, senza passare da fprintf. Il buffer viene scritto con write(2)
+ * solo quando è pieno, quindi il kernel riceve pochi blocchi grandi
+ */
+#include "csv_writer.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * prepara il writer per un file già aperto
+ * il buffer stdio del file viene svuotato prima, così il csv segue quanto già
+ * scritto con fprintf; se lo svuotamento fallisce il writer parte già in errore.
+ * Se il FILE non ha un descrittore si usa fwrite
+ *
+ * parametri
+ *   writer: writer da inizializzare
+ *   file: file di destinazione
+ */
+void init_csv_writer(CsvWriter *writer, FILE *file) {
+    writer->file = file;
+    writer->fd = fileno(file);
+    writer->used = 0;
+    writer->failed = 0;
+    if (fflush(file) != 0) {
+        perror("Failed to write output file");
+        writer->failed = 1;
+    }
+    writer->buffer = malloc(CSV_BUFFER_SIZE);
+    if (!writer->buffer) {
+        fprintf(stderr, "Memory allocation failed for csv buffer\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * scrive un blocco sul file, ripetendo write finché non è stato scritto tutto
+ */
+static void write_block(CsvWriter *writer, const char *data, size_t size) {
+    if (writer->failed) {
+        return;
+    }
+    if (writer->fd < 0) {
+        if (fwrite(data, 1, size, writer->file) != size) {
+            perror("Failed to write output file");
+            writer->failed = 1;
+        }
+        return;
+    }
+    while (size > 0) {
+        ssize_t written = write(writer->fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Failed to write output file");
+            writer->failed = 1;
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+/*
+ * scrive i byte in sospeso nel buffer
+ */
+void flush_csv_writer(CsvWriter *writer) {
+    write_block(writer, writer->buffer, writer->used);
+    writer->used = 0;
+}
+
+/*
+ * accoda byte che non entrano nello spazio rimasto: svuota il buffer e, se il
+ * blocco è più grande dell'intero buffer, lo scrive direttamente
+ */
+void csv_write_slow(CsvWriter *writer, const char *data, size_t size) {
+    flush_csv_writer(writer);
+    if (size >= CSV_BUFFER_SIZE) {
+        write_block(writer, data, size);
+        return;
+    }
+    memcpy(writer->buffer, data, size);
+    writer->used = size;
+}
+
+/*
+ * scrive i byte in sospeso e libera il buffer
+ *
+ * ritorno
+ *   0 se tutte le scritture sono riuscite, -1 altrimenti
+ */
+int close_csv_writer(CsvWriter *writer) {
+    flush_csv_writer(writer);
+    free(writer->buffer);
+    writer->buffer = NULL;
+    return writer->failed ? -1 : 0;
+}
+
+/*
+ * formatta una frequenza relativa come faceva sprintf("%.4f")
+ * il float vale esattamente m / 2^k con m intero a 24 bit: le quattro cifre
+ * decimali sono quindi m * 10000 / 2^k, arrotondato al pari quando il resto è
+ * esattamente metà, come fa printf sul valore binario esatto. Da 0.9999 in su
+ * la frequenza viene scritta come "1"
+ *
+ * parametri
+ *   frequency: frequenza tra 0 e 1
+ *   out: buffer di almeno CSV_FREQUENCY_SIZE byte, senza terminatore
+ *
+ * ritorno
+ *   il numero di caratteri scritti
+ */
+size_t format_csv_frequency(float frequency, char *out) {
+    if (frequency >= 0.9999) {
+        out[0] = '1';
+        return 1;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &frequency, sizeof(bits));
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint64_t mantissa = bits & 0x7FFFFF;
+    unsigned shift = 149; // valori subnormali: m / 2^149
+    if (exponent != 0) {
+        mantissa |= 0x800000;
+        shift = 150 - exponent;
+    }
+
+    // frequency < 1, quindi shift >= 24; oltre 63 il valore arrotonda comunque a zero
+    uint64_t digits = 0;
+    if (shift < 64) {
+        uint64_t scaled = mantissa * 10000;
+        uint64_t half = (uint64_t)1 << (shift - 1);
+        uint64_t remainder = scaled & ((half << 1) - 1);
+        digits = scaled >> shift;
+        if (remainder > half || (remainder == half && (digits & 1))) {
+            digits++;
+        }
+    }
+
+    out[0] = '0';
+    out[1] = '.';
+    out[5] = (char)('0' + digits % 10);
+    digits /= 10;
+    out[4] = (char)('0' + digits % 10);
+    digits /= 10;
+    out[3] = (char)('0' + digits % 10);
+    out[2] = (char)('0' + digits / 10);
+    return CSV_FREQUENCY_SIZE;
+}
+
+/*
+ * formatta un conteggio in decimale, senza zeri iniziali
+ *
+ * parametri
+ *   count: conteggio da scrivere
+ *   out: buffer di almeno CSV_COUNT_SIZE byte, senza terminatore
+ *
+ * ritorno
+ *   il numero di caratteri scritti
+ */
+size_t format_csv_count(uint32_t count, char *out) {
+    char digits[CSV_COUNT_SIZE];
+    size_t length = 0;
+    do {
+        digits[CSV_COUNT_SIZE - 1 - length++] = (char)('0' + count % 10);
+        count /= 10;
+    } while (count > 0);
+    memcpy(out, digits + CSV_COUNT_SIZE - length, length);
+    return length;
+}
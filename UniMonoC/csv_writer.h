@@ -0,0 +1,58 @@
+#ifndef CSV_WRITER_H
+#define CSV_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CSV_BUFFER_SIZE (1024 * 1024) // buffer del writer, scritto a blocchi interi
+#define CSV_FREQUENCY_SIZE 6          // "0.dddd" oppure "1"
+#define CSV_COUNT_SIZE 10             // cifre decimali di un uint32_t
+
+// writer con buffer proprio: i campi vengono copiati nel buffer e scritti con write(2)
+typedef struct CsvWriter {
+    FILE *file;         // destinazione
+    int fd;             // descrittore di file, -1 se il FILE non ne ha uno (si usa fwrite)
+    char *buffer;
+    size_t used;
+    int failed;         // una scrittura è fallita
+} CsvWriter;
+
+// prepara il writer; svuota prima il buffer stdio del file
+void init_csv_writer(CsvWriter *writer, FILE *file);
+
+// scrive i byte in sospeso e libera il buffer; ritorna 0 se tutte le scritture sono riuscite
+int close_csv_writer(CsvWriter *writer);
+
+// scrive i byte in sospeso
+void flush_csv_writer(CsvWriter *writer);
+
+// formatta una frequenza come "%.4f", oppure "1" da 0.9999 in su; ritorna la lunghezza
+size_t format_csv_frequency(float frequency, char *out);
+
+// formatta un conteggio in decimale; ritorna la lunghezza
+size_t format_csv_count(uint32_t count, char *out);
+
+// accoda i byte che non entrano nel buffer; usata da csv_write
+void csv_write_slow(CsvWriter *writer, const char *data, size_t size);
+
+// accoda size byte al buffer
+static inline void csv_write(CsvWriter *writer, const char *data, size_t size) {
+    if (CSV_BUFFER_SIZE - writer->used < size) {
+        csv_write_slow(writer, data, size);
+        return;
+    }
+    memcpy(writer->buffer + writer->used, data, size);
+    writer->used += size;
+}
+
+// accoda un carattere al buffer
+static inline void csv_put(CsvWriter *writer, char c) {
+    if (writer->used == CSV_BUFFER_SIZE) {
+        flush_csv_writer(writer);
+    }
+    writer->buffer[writer->used++] = c;
+}
+
+#endif // CSV_WRITER_H
@@ -0,0 +1,490 @@
+/*
+ * modello indicizzato per la generazione del testo
+ * le coppie lette dal csv vengono raccolte in un ModelBuilder e poi ordinate per
+ * parola corrente: ogni parola ottiene un blocco contiguo di successori, trovato
+ * in tempo costante tramite il suo id, e un indice hash permette di passare
+ * da una parola al suo id
+ */
+#include "generation_model.h"
+#include "utf8.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * inizializza un modello vuoto, senza parole né successori
+ *
+ * parametri
+ *   model: modello da inizializzare
+ */
+void init_generation_model(GenerationModel *model) {
+    memset(model, 0, sizeof(*model));
+    init_arena(&model->arena, MODEL_SLAB_SIZE);
+    model->firstWord = NO_STRING;
+    model->lastWord = NO_STRING;
+}
+
+/*
+ * inizializza il costruttore del modello
+ *
+ * parametri
+ *   builder: costruttore da inizializzare
+ */
+void init_model_builder(ModelBuilder *builder) {
+    memset(builder, 0, sizeof(*builder));
+    init_arena(&builder->arena, MODEL_SLAB_SIZE);
+    init_string_pool(&builder->words, 1024, &builder->arena);
+}
+
+/*
+ * aggiunge una coppia di parole con il suo peso
+ *
+ * parametri
+ *   builder: costruttore del modello
+ *   word: parola corrente
+ *   next_word: parola successiva
+ *   weight: peso della transizione
+ */
+void model_builder_add(ModelBuilder *builder, const char *word, const char *next_word, uint32_t weight) {
+    uint32_t from = intern_string(&builder->words, word);
+    model_builder_add_ids(builder, from, intern_string(&builder->words, next_word), weight);
+}
+
+/*
+ * porta lo spazio delle coppie ad almeno capacity elementi
+ * permette di riempire from, to e weight per posizione, anche da più thread
+ *
+ * parametri
+ *   builder: costruttore del modello
+ *   capacity: numero di coppie da poter contenere
+ */
+void model_builder_reserve(ModelBuilder *builder, size_t capacity) {
+    if (capacity <= builder->capacity) {
+        return;
+    }
+    uint32_t *fromIds = realloc(builder->from, capacity * sizeof(uint32_t));
+    uint32_t *toIds = realloc(builder->to, capacity * sizeof(uint32_t));
+    uint32_t *weights = realloc(builder->weight, capacity * sizeof(uint32_t));
+    if (!fromIds || !toIds || !weights) {
+        fprintf(stderr, "Memory allocation failed for model builder\n");
+        exit(EXIT_FAILURE);
+    }
+    builder->from = fromIds;
+    builder->to = toIds;
+    builder->weight = weights;
+    builder->capacity = capacity;
+}
+
+/*
+ * aggiunge una coppia di parole già internate in builder->words
+ *
+ * parametri
+ *   builder: costruttore del modello
+ *   from: id della parola corrente
+ *   to: id della parola successiva
+ *   weight: peso della transizione
+ */
+void model_builder_add_ids(ModelBuilder *builder, uint32_t from, uint32_t to, uint32_t weight) {
+    if (builder->count == builder->capacity) {
+        model_builder_reserve(builder, builder->capacity ? builder->capacity * 2 : 1024);
+    }
+    builder->from[builder->count] = from;
+    builder->to[builder->count] = to;
+    builder->weight[builder->count] = weight;
+    builder->count++;
+}
+
+/*
+ * copia le parole di un insieme di stringhe nel modello e costruisce l'indice hash
+ * gli id delle parole nel modello coincidono con quelli dell'insieme
+ *
+ * parametri
+ *   model: modello inizializzato
+ *   words: parole da copiare
+ */
+void set_model_words(GenerationModel *model, const StringPool *words) {
+    size_t dataSize = 0;
+    for (uint32_t id = 0; id < words->count; id++) {
+        dataSize += strlen(pool_string(words, id)) + 1;
+    }
+
+    uint32_t indexSize = 16;
+    while (indexSize < words->count * 2) {
+        indexSize <<= 1; // fattore di carico al massimo 0.5
+    }
+
+    char *data = arena_alloc(&model->arena, dataSize > 0 ? dataSize : 1);
+    uint32_t *offsets = arena_alloc(&model->arena, (words->count + 1) * sizeof(uint32_t));
+    uint32_t *index = arena_alloc(&model->arena, indexSize * sizeof(uint32_t));
+    memset(index, 0, indexSize * sizeof(uint32_t));
+
+    size_t offset = 0;
+    for (uint32_t id = 0; id < words->count; id++) {
+        const char *word = pool_string(words, id);
+        size_t length = strlen(word) + 1;
+        memcpy(data + offset, word, length);
+        offsets[id] = (uint32_t)offset;
+        offset += length;
+
+        uint32_t slot = words->hashes[id] & (indexSize - 1);
+        while (index[slot]) {
+            slot = (slot + 1) & (indexSize - 1);
+        }
+        index[slot] = id + 1;
+    }
+
+    model->wordCount = words->count;
+    model->wordData = data;
+    model->wordOffsets = offsets;
+    model->wordIndex = index;
+    model->indexSize = indexSize;
+}
+
+/*
+ * costruisce la tabella alias di un blocco di successori con il metodo di Vose
+ * la tabella è intera ed esatta: ogni colonna ha una capacità pari alla somma
+ * dei pesi T e contiene la soglia sotto la quale si tiene il proprio successore
+ * e la posizione del successore alternativo; i pesi nulli non vengono mai scelti.
+ * Solo se T supera 2^32 - 1 i pesi vengono ridotti, arrotondando per eccesso
+ *
+ * parametri
+ *   weights: pesi del blocco
+ *   count: numero di successori del blocco
+ *   first: posizione del blocco nell'array dei successori
+ *   threshold, alias: colonne della tabella, già posizionate sul blocco
+ *   scaled, small, large: spazio di lavoro di almeno count elementi
+ *
+ * ritorno
+ *   la capacità T delle colonne, 0 se nessun successore è estraibile
+ */
+static uint32_t build_alias_block(const uint32_t *weights, uint32_t count, uint32_t first,
+                                  uint32_t *threshold, uint32_t *alias,
+                                  uint64_t *scaled, uint32_t *small, uint32_t *large) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total += weights[i];
+    }
+    if (total == 0) {
+        // nessun successore estraibile: la parola si comporta come senza successori
+        for (uint32_t i = 0; i < count; i++) {
+            threshold[i] = 0;
+            alias[i] = NO_STRING;
+        }
+        return 0;
+    }
+
+    // riduzione dei pesi solo per somme oltre 32 bit
+    int shift = 0;
+    while ((total >> shift) + count > UINT32_MAX) {
+        shift++;
+    }
+    if (shift > 0) {
+        total = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            total += ((uint64_t)weights[i] + ((uint64_t)1 << shift) - 1) >> shift;
+        }
+    }
+
+    // massa di ogni colonna in unità intere: la media delle colonne è esattamente total
+    uint32_t smallCount = 0;
+    uint32_t largeCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t weight = ((uint64_t)weights[i] + ((uint64_t)1 << shift) - 1) >> shift;
+        scaled[i] = weight * count;
+        if (scaled[i] < total) {
+            small[smallCount++] = i;
+        } else {
+            large[largeCount++] = i;
+        }
+    }
+
+    while (smallCount > 0 && largeCount > 0) {
+        uint32_t less = small[--smallCount];
+        uint32_t more = large[--largeCount];
+        threshold[less] = (uint32_t)scaled[less];
+        alias[less] = first + more;
+        scaled[more] -= total - scaled[less];
+        if (scaled[more] < total) {
+            small[smallCount++] = more;
+        } else {
+            large[largeCount++] = more;
+        }
+    }
+    // con l'aritmetica intera le colonne rimaste sono piene
+    while (largeCount > 0) {
+        uint32_t i = large[--largeCount];
+        threshold[i] = (uint32_t)total;
+        alias[i] = first + i;
+    }
+    while (smallCount > 0) {
+        uint32_t i = small[--smallCount];
+        threshold[i] = (uint32_t)total;
+        alias[i] = first + i;
+    }
+    return (uint32_t)total;
+}
+
+/*
+ * costruisce le tabelle alias di tutte le parole del modello
+ * richiede che successorStart, successors e weights siano già pronti
+ *
+ * parametri
+ *   model: modello da completare
+ */
+void build_alias_tables(GenerationModel *model) {
+    uint32_t total = model->successorTotal;
+    uint32_t *threshold = arena_alloc(&model->arena, (total + 1) * sizeof(uint32_t));
+    uint32_t *alias = arena_alloc(&model->arena, (total + 1) * sizeof(uint32_t));
+    uint32_t *capacity = arena_alloc(&model->arena, (model->wordCount + 1) * sizeof(uint32_t));
+
+    uint32_t maxCount = 0;
+    for (uint32_t id = 0; id < model->wordCount; id++) {
+        if (model_successor_count(model, id) > maxCount) {
+            maxCount = model_successor_count(model, id);
+        }
+    }
+    uint64_t *scaled = malloc((maxCount + 1) * sizeof(uint64_t));
+    uint32_t *small = malloc((maxCount + 1) * sizeof(uint32_t));
+    uint32_t *large = malloc((maxCount + 1) * sizeof(uint32_t));
+    if (!scaled || !small || !large) {
+        fprintf(stderr, "Memory allocation failed for alias table\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t id = 0; id < model->wordCount; id++) {
+        uint32_t first = model->successorStart[id];
+        uint32_t count = model_successor_count(model, id);
+        capacity[id] = build_alias_block(model->weights + first, count, first, threshold + first, alias + first,
+                                         scaled, small, large);
+    }
+
+    free(scaled);
+    free(small);
+    free(large);
+    model->aliasThreshold = threshold;
+    model->aliasIndex = alias;
+    model->aliasCapacity = capacity;
+}
+
+/*
+ * costruisce il modello dalle coppie raccolte e libera il costruttore
+ * le coppie vengono raggruppate per parola corrente con un ordinamento per conteggio,
+ * poi per ogni parola viene precalcolata la tabella alias dei successori
+ *
+ * parametri
+ *   builder: costruttore con le coppie raccolte
+ *   model: modello da costruire
+ */
+void finish_model_builder(ModelBuilder *builder, GenerationModel *model) {
+    init_generation_model(model);
+    set_model_words(model, &builder->words);
+
+    uint32_t wordCount = model->wordCount;
+    uint32_t *start = arena_alloc(&model->arena, (wordCount + 1) * sizeof(uint32_t));
+    uint32_t *successors = arena_alloc(&model->arena, (builder->count + 1) * sizeof(uint32_t));
+    uint32_t *weights = arena_alloc(&model->arena, (builder->count + 1) * sizeof(uint32_t));
+
+    // conta i successori di ogni parola e calcola l'inizio di ciascun blocco
+    memset(start, 0, (wordCount + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < builder->count; i++) {
+        start[builder->from[i] + 1]++;
+    }
+    for (uint32_t id = 0; id < wordCount; id++) {
+        start[id + 1] += start[id];
+    }
+
+    // colloca ogni coppia nel blocco della sua parola
+    uint32_t *fill = malloc((wordCount + 1) * sizeof(uint32_t));
+    if (!fill) {
+        fprintf(stderr, "Memory allocation failed for model builder\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(fill, start, (wordCount + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < builder->count; i++) {
+        uint32_t position = fill[builder->from[i]]++;
+        successors[position] = builder->to[i];
+        weights[position] = builder->weight[i];
+    }
+    free(fill);
+
+    model->successorTotal = (uint32_t)builder->count;
+    model->successorStart = start;
+    model->successors = successors;
+    model->weights = weights;
+    build_alias_tables(model);
+    free_model_builder(builder);
+}
+
+/*
+ * libera il costruttore senza costruire il modello
+ */
+void free_model_builder(ModelBuilder *builder) {
+    free(builder->from);
+    free(builder->to);
+    free(builder->weight);
+    free_string_pool(&builder->words);
+    free_arena(&builder->arena);
+    memset(builder, 0, sizeof(*builder));
+}
+
+/*
+ * cerca l'id di una parola tramite l'indice hash
+ *
+ * parametri
+ *   model: modello di generazione
+ *   word: parola da cercare
+ *
+ * ritorno
+ *   l'id della parola oppure NO_STRING se non è presente
+ */
+uint32_t find_model_word(const GenerationModel *model, const char *word) {
+    uint32_t mask = model->indexSize - 1;
+    for (uint32_t slot = hash_string(word) & mask; model->wordIndex[slot]; slot = (slot + 1) & mask) {
+        uint32_t id = model->wordIndex[slot] - 1;
+        if (strcmp(model_word(model, id), word) == 0) {
+            return id;
+        }
+    }
+    return NO_STRING;
+}
+
+/*
+ * sceglie casualmente il successore di una parola in proporzione ai pesi
+ * usa la tabella alias del blocco: una colonna a caso e un intero a caso sotto
+ * la capacità delle colonne, quindi il costo non dipende dal numero di
+ * successori e, con i pesi interi, le probabilità sono esatte
+ *
+ * parametri
+ *   model: modello di generazione
+ *   word: id della parola corrente
+ *   rng: generatore pseudocasuale del thread
+ *
+ * ritorno
+ *   l'id della parola scelta, oppure NO_STRING se la parola non ha successori
+ */
+uint32_t sample_next_word(const GenerationModel *model, uint32_t word, Rng *rng) {
+    uint32_t first = model->successorStart[word];
+    uint32_t count = model->successorStart[word + 1] - first;
+    if (count == 0) {
+        return NO_STRING;
+    }
+
+    uint32_t capacity = model->aliasCapacity[word];
+    if (capacity == 0) {
+        return NO_STRING;
+    }
+
+    uint32_t column = first + rng_below(rng, count);
+    if (rng_below(rng, capacity) < model->aliasThreshold[column]) {
+        return model->successors[column];
+    }
+    uint32_t alias = model->aliasIndex[column];
+    return alias == NO_STRING ? NO_STRING : model->successors[alias];
+}
+
+/*
+ * sceglie una parola iniziale tra quelle che seguono '.', '?' o '!'
+ * ogni coppia (punteggiatura, parola) ha la stessa probabilità di essere scelta
+ *
+ * parametri
+ *   model: modello di generazione
+ *   rng: generatore pseudocasuale del thread
+ *
+ * ritorno
+ *   l'id della parola scelta, oppure NO_STRING se nessuna parola segue una punteggiatura
+ */
+uint32_t select_initial_word(const GenerationModel *model, Rng *rng) {
+    static const char *initialPunctuations[] = {".", "?", "!"};
+    uint32_t ids[3];
+    uint32_t initialCount = 0;
+
+    for (int i = 0; i < 3; i++) {
+        ids[i] = find_model_word(model, initialPunctuations[i]);
+        if (ids[i] != NO_STRING) {
+            initialCount += model_successor_count(model, ids[i]);
+        }
+    }
+    if (initialCount == 0) {
+        return NO_STRING;
+    }
+
+    uint32_t r = rng_below(rng, initialCount);
+    for (int i = 0; i < 3; i++) {
+        if (ids[i] == NO_STRING) continue;
+        uint32_t count = model_successor_count(model, ids[i]);
+        if (r < count) {
+            return model->successors[model->successorStart[ids[i]] + r];
+        }
+        r -= count;
+    }
+    return NO_STRING;
+}
+
+/*
+ * scrive una parola seguita da uno spazio, con il primo carattere in maiuscolo
+ * il primo carattere viene decodificato da UTF-8, così anche le lettere
+ * accentate diventano maiuscole senza spezzare la sequenza
+ */
+static void write_capitalized(const char *word, FILE *file) {
+    size_t length = 0;
+    size_t size = strlen(word);
+    if (size > 0) {
+        uint32_t first;
+        length = utf8_decode(word, size, &first);
+        if (first == UTF8_INVALID) {
+            fwrite(word, 1, length, file);
+        } else {
+            char upper[4];
+            fwrite(upper, 1, utf8_encode(utf8_upper(first), upper), file);
+        }
+    }
+    fprintf(file, "%s ", word + length);
+}
+
+/*
+ * genera un testo a partire da una parola iniziale
+ * la prima parola e quelle dopo '.', '?' o '!' vengono scritte con l'iniziale maiuscola
+ *
+ * parametri
+ *   model: modello di generazione
+ *   start: id della parola iniziale
+ *   wordCount: numero di parole da generare, inclusa quella iniziale
+ *   rng: generatore pseudocasuale del thread
+ *   file: file su cui scrivere il testo
+ *
+ * ritorno
+ *   il numero di parole scritte; è minore di wordCount se si raggiunge una parola senza successori
+ */
+int generate_text(const GenerationModel *model, uint32_t start, int wordCount, Rng *rng, FILE *file) {
+    int isNewSentence = 1;
+    uint32_t current = start;
+    int written = 0;
+
+    while (written < wordCount && current != NO_STRING) {
+        const char *word = model_word(model, current);
+        if (isNewSentence) {
+            // capitalizzazione della prima parola di una frase
+            write_capitalized(word, file);
+        } else {
+            fprintf(file, "%s ", word);
+        }
+        written++;
+        isNewSentence = strcmp(word, ".") == 0 || strcmp(word, "!") == 0 || strcmp(word, "?") == 0;
+        if (written < wordCount) {
+            current = sample_next_word(model, current, rng);
+        }
+    }
+    return written;
+}
+
+/*
+ * libera la memoria del modello, compreso l'eventuale file mappato
+ */
+void free_generation_model(GenerationModel *model) {
+    if (model->mapping) {
+        munmap(model->mapping, model->mappingSize);
+    }
+    free_arena(&model->arena);
+    memset(model, 0, sizeof(*model));
+}
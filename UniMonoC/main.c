@@ -1,10 +1,232 @@
 #include "text_analysis.h"
 #include "text_generation.h"
+#include "parallel_analysis.h"
+#include "generation_model.h"
+#include "binary_model.h"
+#include "csv_model.h"
+#include "batch_generation.h"
+#include "rng.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * stampa le statistiche dell'allocatore del modello
+ *
+ * parametri
+ *   stats: statistiche da stampare
+ */
+static void print_memory_stats(const ArenaStats *stats) {
+    printf("Model memory: %zu bytes reserved, %zu bytes used, %zu slabs\n",
+           stats->reserved, stats->used, stats->slabCount);
+}
+
+/*
+ * indica se il file di output dell'analisi deve usare il formato binario
+ * il formato viene scelto dall'estensione: ".bin" per il modello binario, csv altrimenti
+ */
+static int is_binary_model_path(const char *path) {
+    size_t length = strlen(path);
+    return length >= 4 && strcmp(path + length - 4, ".bin") == 0;
+}
+
+/*
+ * indica se il file di output dell'analisi deve contenere i conteggi esatti
+ * invece delle frequenze relative: ".counts.csv"
+ */
+static int is_counts_model_path(const char *path) {
+    size_t length = strlen(path);
+    return length >= 11 && strcmp(path + length - 11, ".counts.csv") == 0;
+}
+
+/*
+ * costruisce il modello dalle tabelle dell'analisi e lo scrive nel formato binario
+ *
+ * parametri
+ *   tables: tabelle prodotte dall'analisi
+ *   tableCount: numero di tabelle
+ *   firstWord, lastWord: prima e ultima parola del testo
+ *   file: file di output
+ *
+ * ritorno
+ *   1 se la scrittura è riuscita, 0 altrimenti
+ */
+static int write_model_file(const WordTable *tables, size_t tableCount,
+                            const char *firstWord, const char *lastWord, FILE *file) {
+    GenerationModel model;
+    build_model_from_tables(tables, tableCount, firstWord, lastWord, &model);
+    int written = write_binary_model(&model, file);
+    free_generation_model(&model);
+    if (!written) {
+        perror("Failed to write binary model");
+    }
+    return written;
+}
+
+/*
+ * scrive il risultato di un'analisi seriale nel formato scelto dall'estensione
+ * del file di output: modello binario, csv dei conteggi o csv delle frequenze
+ *
+ * parametri
+ *   table: tabella delle parole
+ *   firstWord, lastWord: prima e ultima parola del testo
+ *   path: percorso del file di output
+ *   file: file di output aperto in scrittura
+ *
+ * ritorno
+ *   1 se la scrittura è riuscita, 0 altrimenti
+ */
+static int write_analysis(const WordTable *table, const char *firstWord, const char *lastWord,
+                          const char *path, FILE *file) {
+    if (is_binary_model_path(path)) {
+        return write_model_file(table, 1, firstWord, lastWord, file); // modello binario
+    }
+    if (is_counts_model_path(path)) {
+        print_counts_header(file, firstWord, lastWord); // conteggi esatti delle coppie
+        return print_word_counts(table, file) == 0;
+    }
+    return print_word_table(table, file, firstWord) == 0; // stampa la tabella delle parole nel file di output
+}
+
+/*
+ * chiude il file di output; un errore qui significa che gli ultimi dati
+ * rimasti nel buffer non sono stati scritti
+ *
+ * ritorno
+ *   1 se la chiusura è riuscita, 0 altrimenti
+ */
+static int close_output_file(FILE *file) {
+    if (fclose(file) != 0) {
+        perror("Failed to write output file");
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * apre il file su cui scrivere un modello che ne sostituisce uno esistente
+ * se path è un file regolare, o non esiste ancora, si scrive su un file
+ * temporaneo nella stessa cartella: il modello vecchio resta intatto finché
+ * replace_output_file non lo sostituisce con rename. Le altre destinazioni
+ * (ad esempio /dev/stdout) vengono aperte e scritte direttamente
+ *
+ * parametri
+ *   path: percorso del file di output
+ *   tempPath: riceve il percorso del file temporaneo, NULL se non viene usato
+ *
+ * ritorno
+ *   il file aperto in scrittura, NULL in caso di errore
+ */
+static FILE *open_replacement_file(const char *path, char **tempPath) {
+    *tempPath = NULL;
+    struct stat info;
+    int exists = stat(path, &info) == 0;
+    if (exists && !S_ISREG(info.st_mode)) {
+        return fopen(path, "w");
+    }
+
+    size_t length = strlen(path);
+    char *name = malloc(length + 8);
+    if (!name) {
+        fprintf(stderr, "Memory allocation failed for temporary file name\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(name, path, length);
+    memcpy(name + length, ".XXXXXX", 8);
+    int fd = mkstemp(name);
+    if (fd < 0) {
+        free(name);
+        return NULL;
+    }
+
+    // mkstemp crea il file con permessi 0600: si usano quelli del modello sostituito,
+    // oppure quelli che fopen avrebbe dato a un file nuovo
+    mode_t mode = info.st_mode & 0777;
+    if (!exists) {
+        mode_t mask = umask(0);
+        umask(mask);
+        mode = 0666 & ~mask;
+    }
+    fchmod(fd, mode);
+
+    FILE *file = fdopen(fd, "w");
+    if (!file) {
+        close(fd);
+        unlink(name);
+        free(name);
+        return NULL;
+    }
+    *tempPath = name;
+    return file;
+}
+
+/*
+ * completa la scrittura iniziata con open_replacement_file
+ * chiude il file e, se tutto è stato scritto, sposta il file temporaneo sul
+ * percorso finale; altrimenti lo cancella e il file di destinazione non cambia
+ *
+ * parametri
+ *   file: file aperto da open_replacement_file
+ *   tempPath: file temporaneo, NULL se si è scritto direttamente su path; viene liberato
+ *   path: percorso del file di output
+ *   written: 1 se la scrittura dei dati è riuscita
+ *
+ * ritorno
+ *   1 se il file di output contiene il modello completo, 0 altrimenti
+ */
+static int replace_output_file(FILE *file, char *tempPath, const char *path, int written) {
+    if (!close_output_file(file)) {
+        written = 0;
+    }
+    if (!tempPath) {
+        return written;
+    }
+    if (written && rename(tempPath, path) != 0) {
+        perror("Failed to replace output file");
+        written = 0;
+    }
+    if (!written) {
+        unlink(tempPath);
+    }
+    free(tempPath);
+    return written;
+}
+
+/*
+ * carica il modello di generazione da un modello binario o da un file csv
+ * un modello binario viene mappato e usato così com'è, senza nessuna lettura
+ *
+ * parametri
+ *   path: percorso del file del modello
+ *   model: modello da inizializzare
+ *
+ * ritorno
+ *   1 se il modello è stato caricato, 0 in caso di errore
+ */
+static int load_model(const char *path, GenerationModel *model) {
+    uint32_t version;
+    int loaded = load_binary_model(path, model, &version);
+    if (loaded == BINARY_MODEL_UNSUPPORTED) {
+        fprintf(stderr, "Unsupported model version %u in %s, regenerate it with analyze\n", (unsigned)version, path);
+        return 0;
+    }
+    if (loaded < 0) {
+        fprintf(stderr, "Corrupted binary model: %s\n", path);
+        return 0;
+    }
+    if (loaded) {
+        return 1;
+    }
+
+    // costruisce il modello indicizzato direttamente dal csv mappato, su tutti i core
+    if (!load_csv_model(path, 0, model)) {
+        fprintf(stderr, "Failed to load frequency list from file: %s\n", path);
+        return 0;
+    }
+    return 1;
+}
 
 /*
  * programma principale per l'analisi e la generazione di testo
@@ -19,20 +241,80 @@
 int main(int argc, char *argv[]) {
     printf("Program started\n");
 
-    srand(time(NULL)); // inizializza il generatore di numeri casuali
-
     // controllo minimo degli argomenti passati al programma
     if (argc < 2) {
         printf("Usage: %s <command> [options]\n", argv[0]);
         printf("Commands:\n");
-        printf("  analyze <inputfile> <outputfile>\n");
-        printf("  generate <inputfile> <outputfile> <wordcount> [startword]\n");
+        printf("  analyze <inputfile> <outputfile> [threads]   (outputfile *.bin: binary model, *.counts.csv: exact counts)\n");
+        printf("  generate <inputfile> <outputfile> <wordcount> [startword]   (inputfile: csv or binary model)\n");
+        printf("  update <modelfile> <inputfile> <outputfile>   (modelfile: *.counts.csv; adds the new text to the model)\n");
+        printf("  batch <inputfile> <output> <textcount> <wordcount> [startword,...] [threads] [seed]\n");
+        printf("        (output with %%d: one file per text; threads 0: all cores)\n");
         return 1;
     }
 
     const char *command = argv[1]; // legge il comando dal primo argomento
 
-    if (strcmp(command, "analyze") == 0 && argc == 4) {
+    if (strcmp(command, "analyze") == 0 && argc == 5) {
+        // gestisce il comando "analyze" su più thread; 0 usa tutti i core disponibili
+        int threadCount = atoi(argv[4]);
+        if (threadCount < 0) {
+            fprintf(stderr, "Invalid number of threads: %s\n", argv[4]);
+            return 1;
+        }
+
+        FILE *outputFile = fopen(argv[3], "w"); // apertura del file di output per scrittura
+        if (!outputFile) {
+            perror("Failed to open output file");
+            return 1;
+        }
+
+        int binaryOutput = is_binary_model_path(argv[3]);
+        int status = 0;
+        ParallelAnalysis result;
+        ArenaStats stats;
+        if (analyze_file_parallel(argv[2], threadCount, &result)) {
+            if (binaryOutput) {
+                status = !write_model_file(result.parts, result.partCount, result.firstWord,
+                                           result.lastWord, outputFile);
+            } else if (is_counts_model_path(argv[3])) {
+                status = print_parallel_counts(&result, outputFile) != 0;
+            } else {
+                status = print_parallel_analysis(&result, outputFile) != 0;
+            }
+            get_parallel_analysis_stats(&result, &stats);
+            free_parallel_analysis(&result);
+        } else {
+            // il file non è mappabile (ad esempio una pipe): analisi seriale
+            FILE *inputFile = fopen(argv[2], "r");
+            if (!inputFile) {
+                perror("Failed to open input file");
+                fclose(outputFile);
+                return 1;
+            }
+
+            WordTable table;
+            char *firstWord = NULL;
+            char *lastWord = NULL;
+            init_word_table(&table, HASH_SIZE);
+            analyze_text(inputFile, &table, &firstWord, &lastWord);
+            status = !write_analysis(&table, firstWord, lastWord, argv[3], outputFile);
+            get_word_table_stats(&table, &stats);
+
+            free_word_table(&table);
+            free(firstWord);
+            free(lastWord);
+            fclose(inputFile);
+        }
+        if (!close_output_file(outputFile)) {
+            status = 1;
+        }
+        print_memory_stats(&stats);
+        if (status) {
+            return 1;
+        }
+
+    } else if (strcmp(command, "analyze") == 0 && argc == 4) {
         // gestisce il comando "analyze" per analizzare un testo
         FILE *inputFile = fopen(argv[2], "r"); // apertura del file di input per la lettura
         if (!inputFile) {
@@ -54,14 +336,68 @@ int main(int argc, char *argv[]) {
         init_word_table(&table, HASH_SIZE); // inizializza la tabella delle parole
 
         analyze_text(inputFile, &table, &firstWord, &lastWord); // analizza il testo e popola la tabella
-        print_word_table(&table, outputFile, firstWord); // stampa la tabella delle parole nel file di output
+        int status = !write_analysis(&table, firstWord, lastWord, argv[3], outputFile);
+
+        ArenaStats stats;
+        get_word_table_stats(&table, &stats);
+        print_memory_stats(&stats);
 
         // pulizia e chiusura delle risorse
         free_word_table(&table);
         free(firstWord);
         free(lastWord);
         fclose(inputFile);
-        fclose(outputFile);
+        if (!close_output_file(outputFile)) {
+            status = 1;
+        }
+        if (status) {
+            return 1;
+        }
+
+    } else if (strcmp(command, "update") == 0 && argc == 5) {
+        // gestisce il comando "update": riprende i conteggi di un modello e analizza solo il testo nuovo
+        WordTable table;
+        char *firstWord = NULL;
+        char *lastWord = NULL;
+        init_word_table(&table, HASH_SIZE);
+        if (!load_counts_table(argv[2], &table, &firstWord, &lastWord)) {
+            free_word_table(&table);
+            return 1;
+        }
+
+        FILE *inputFile = fopen(argv[3], "r");
+        if (!inputFile) {
+            perror("Failed to open input file");
+            free_word_table(&table);
+            free(firstWord);
+            free(lastWord);
+            return 1;
+        }
+        continue_analysis(inputFile, &table, &firstWord, &lastWord);
+        fclose(inputFile);
+
+        // il modello aggiornato passa da un file temporaneo, così può sostituire quello letto
+        // senza troncarlo se la scrittura fallisce
+        char *tempPath;
+        FILE *outputFile = open_replacement_file(argv[4], &tempPath);
+        int status = 0;
+        if (!outputFile) {
+            perror("Failed to open output file");
+            status = 1;
+        } else {
+            int written = write_analysis(&table, firstWord, lastWord, argv[4], outputFile);
+            status = !replace_output_file(outputFile, tempPath, argv[4], written);
+        }
+
+        ArenaStats stats;
+        get_word_table_stats(&table, &stats);
+        print_memory_stats(&stats);
+        free_word_table(&table);
+        free(firstWord);
+        free(lastWord);
+        if (status) {
+            return 1;
+        }
 
     } else if (strcmp(command, "generate") == 0 && argc >= 5) {
         // gestisce il comando "generate" per generare testo basato sulla frequenza delle parole
@@ -71,86 +407,100 @@ int main(int argc, char *argv[]) {
             return 1;
         }
 
-        FrequencyNode *head = NULL;
-        init_frequency_list(&head); // inizializza la lista delle frequenze
-        if (!load_frequency_list_from_csv(argv[2], &head)) { // carica la lista delle frequenze dal file csv
-            fprintf(stderr, "Failed to load frequency list from file: %s\n", argv[2]);
+        GenerationModel model;
+        if (!load_model(argv[2], &model)) {
             return 1;
         }
 
         FILE *outputFile = fopen(argv[3], "w"); // apertura del file di output per scrittura
         if (!outputFile) {
             perror("Failed to open output file");
-            free_frequency_list(head);
+            free_generation_model(&model);
             return 1;
         }
 
-        // seleziona la prima e la parola di partenza per la generazione del testo
-        char *currentWord;
-        //char *originalFirstWord = NULL;
-        char *startWord = NULL;
+        Rng rng;
+        rng_seed(&rng, rng_default_seed()); // inizializza il generatore di numeri casuali
 
-        // gestion della parola di partenza per la generazione del testo
+        // gestione della parola di partenza per la generazione del testo
+        uint32_t startWord;
         if (argc == 6) {
-            startWord = to_lowercase(argv[5]);
-            currentWord = strdup(startWord);
-            if (!word_exists_in_frequency_list(head, currentWord)) {
-                fprintf(stderr, "La parola inserita non è presenta nel testo: %s\n", currentWord);
-                free(currentWord);
-                free(startWord);
-                free_frequency_list(head);
+            char *lowerStart = to_lowercase(argv[5]);
+            startWord = find_model_word(&model, lowerStart);
+            if (startWord == NO_STRING || model_successor_count(&model, startWord) == 0) {
+                fprintf(stderr, "La parola inserita non è presenta nel testo: %s\n", lowerStart);
+                free(lowerStart);
+                free_generation_model(&model);
                 fclose(outputFile);
                 return 1;
             }
+            free(lowerStart);
         } else {
-            currentWord = select_random_initial_word(head);
-            if (!currentWord) {
+            startWord = select_initial_word(&model, &rng);
+            if (startWord == NO_STRING) {
                 fprintf(stderr, "Failed to select initial word\n");
-                free_frequency_list(head);
+                free_generation_model(&model);
                 fclose(outputFile);
                 return 1;
             }
-            startWord = strdup(currentWord);
         }
 
+        printf("Starting with word: %s\n", model_word(&model, startWord));
 
-        printf("Starting with word: %s\n", currentWord);
-        int isNewSentence = 1;
+        // generazione delle parole fino al raggiungimento del conteggio desiderato
+        if (generate_text(&model, startWord, wordCount, &rng, outputFile) < wordCount) {
+            fprintf(stderr, "Generated word is NULL.\n");
+        }
 
-        // capitalizzazione della prima parola del nuovo testo, se necessario
-        if (isNewSentence) {
-            currentWord[0] = toupper(currentWord[0]);
+        // chiusura delle risorse dopo la generazione del testo
+        int written = close_output_file(outputFile);
+        free_generation_model(&model);
+        if (!written) {
+            return 1;
         }
-        fprintf(outputFile, "%s ", currentWord);
-        isNewSentence = 0;
 
-        // generazione delle parole fino al raggiungimento del conteggio desiderato
-        for (int i = 1; i < wordCount; i++) {
-            char *word = generate_random_word(head, to_lowercase(currentWord));
-            if (word) {
-                if (isNewSentence) {
-                    word[0] = toupper(word[0]);
-                }
-                fprintf(outputFile, "%s ", word);
-                if (strcmp(word, ".") == 0 || strcmp(word, "!") == 0 || strcmp(word, "?") == 0) {
-                    isNewSentence = 1;
-                } else {
-                    isNewSentence = 0;
-                }
-                free(currentWord);
-                currentWord = to_lowercase(word);
-                free(word);
-            } else {
-                fprintf(stderr, "Generated word is NULL.\n");
-                break;
-            }
+    } else if (strcmp(command, "batch") == 0 && argc >= 6 && argc <= 9) {
+        // gestisce il comando "batch": molti testi con un solo caricamento del modello
+        long textCount = atol(argv[4]);
+        int wordCount = atoi(argv[5]);
+        int threadCount = argc >= 8 ? atoi(argv[7]) : 1;
+        uint64_t seed = argc == 9 ? strtoull(argv[8], NULL, 10) : rng_default_seed();
+        if (textCount <= 0) {
+            fprintf(stderr, "Invalid number of texts to generate: %s\n", argv[4]);
+            return 1;
+        }
+        if (wordCount <= 0) {
+            fprintf(stderr, "Invalid number of words to generate: %s\n", argv[5]);
+            return 1;
+        }
+        if (threadCount < 0) {
+            fprintf(stderr, "Invalid number of threads: %s\n", argv[7]);
+            return 1;
         }
 
-        // chiusura delle risorse dopo la generazione del testo
-        fclose(outputFile);
-        free(currentWord);
-        free(startWord);
-        free_frequency_list(head);
+        GenerationModel model;
+        if (!load_model(argv[2], &model)) {
+            return 1;
+        }
+
+        GenerationJob *jobs = make_generation_jobs(&model, (size_t)textCount, wordCount,
+                                                   argc >= 7 ? argv[6] : NULL);
+        if (!jobs) {
+            free_generation_model(&model);
+            return 1;
+        }
+
+        printf("Seed: %llu\n", (unsigned long long)seed); // permette di ripetere la generazione
+        long completed = generate_batch(&model, jobs, (size_t)textCount, argv[3], threadCount, seed);
+        free(jobs);
+        free_generation_model(&model);
+        if (completed < 0) {
+            return 1;
+        }
+        printf("Generated %ld texts\n", textCount);
+        if (completed < textCount) {
+            fprintf(stderr, "%ld texts ended before reaching %d words\n", textCount - completed, wordCount);
+        }
 
     } else {
         printf("Invalid command or number of arguments.\n");
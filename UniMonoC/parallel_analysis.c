@@ -0,0 +1,325 @@
+/*
+ * analisi del testo su più thread
+ * il file viene mappato in memoria e diviso in blocchi che terminano su uno spazio
+ * o su una punteggiatura; ogni thread costruisce una propria WordTable, poi le coppie
+ * a cavallo dei blocchi vengono ricucite e le tabelle unite in partizioni disgiunte
+ */
+#include "parallel_analysis.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MIN_CHUNK_SIZE (64 * 1024) // sotto questa dimensione un thread in più non conviene
+
+// lavoro assegnato a un thread di analisi
+typedef struct ChunkJob {
+    const char *data;
+    size_t size;
+    WordTable table;
+    TextScanner scanner;
+} ChunkJob;
+
+// lavoro assegnato a un thread di unione
+typedef struct MergeJob {
+    ChunkJob *chunks;
+    size_t chunkCount;
+    const WordTable *boundary;
+    WordTable *part;
+    size_t partIndex;
+    size_t partCount;
+} MergeJob;
+
+/*
+ * determina se un carattere chiude sicuramente una parola
+ * un blocco che inizia subito dopo uno di questi caratteri non spezza nessuna parola
+ */
+static int is_chunk_boundary(char c) {
+    return isspace((unsigned char)c) || c == '.' || c == '?' || c == '!';
+}
+
+/*
+ * thread di analisi: tokenizza un blocco nella propria tabella privata
+ */
+static void *analyze_chunk(void *arg) {
+    ChunkJob *job = arg;
+    init_word_table(&job->table, HASH_SIZE);
+    init_text_scanner(&job->scanner, &job->table);
+    scan_text(&job->scanner, job->data, job->size);
+    finish_text_scanner(&job->scanner);
+    return NULL;
+}
+
+/*
+ * copia nella partizione le parole di una tabella che le appartengono
+ * la partizione di una parola dipende solo dal suo hash
+ */
+static void merge_table_part(WordTable *part, const WordTable *source, size_t partIndex, size_t partCount) {
+    for (size_t i = 0; i < source->size; i++) {
+        const WordNode *node = &source->nodes[i];
+        if (node->successorCount == 0 || source->words.hashes[i] % partCount != partIndex) continue;
+        uint32_t word = word_table_intern(part, pool_string(&source->words, (uint32_t)i));
+        for (uint32_t j = 0; j < node->successorCount; j++) {
+            const SuccessorNode *snode = &node->successors[j];
+            uint32_t next = word_table_intern(part, pool_string(&source->words, snode->word));
+            add_word_ids(part, word, next, snode->frequency);
+        }
+    }
+}
+
+/*
+ * thread di unione: costruisce una partizione della tabella finale
+ */
+static void *merge_part(void *arg) {
+    MergeJob *job = arg;
+    init_word_table(job->part, HASH_SIZE);
+    for (size_t i = 0; i < job->chunkCount; i++) {
+        merge_table_part(job->part, &job->chunks[i].table, job->partIndex, job->partCount);
+    }
+    merge_table_part(job->part, job->boundary, job->partIndex, job->partCount);
+    return NULL;
+}
+
+/*
+ * ricuce le coppie a cavallo dei blocchi, riproducendo le regole dell'analisi seriale
+ * ogni blocco è stato analizzato senza conoscere il testo precedente: qui si
+ * recuperano la coppia (ultimo token, prima parola) e quelle tra l'ultima parola
+ * e la punteggiatura iniziale del blocco
+ *
+ * parametri
+ *   chunks: blocchi analizzati, nell'ordine del testo
+ *   chunkCount: numero di blocchi
+ *   boundary: tabella che riceve le coppie ricucite
+ *   result: riceve la prima e l'ultima parola del testo
+ */
+static void stitch_chunks(ChunkJob *chunks, size_t chunkCount, WordTable *boundary, ParallelAnalysis *result) {
+    static const char *punctuation[3] = {".", "?", "!"};
+    char lastWord[256] = {0};
+    char previousWord[256] = {0};
+    int hasLastWord = 0;
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        TextScanner *scanner = &chunks[i].scanner;
+        const StringPool *words = &chunks[i].table.words;
+        if (scanner->lastWord == NO_STRING) {
+            continue; // blocco senza token
+        }
+
+        int startsWithWord = 1;
+        for (int p = 0; p < 3; p++) {
+            if (scanner->leadingPunctuation[p] > 0) {
+                startsWithWord = 0;
+                if (previousWord[0] != '\0') {
+                    add_word_count(boundary, previousWord, punctuation[p], (uint32_t)scanner->leadingPunctuation[p]);
+                }
+            }
+        }
+        if (startsWithWord && hasLastWord) {
+            add_word(boundary, lastWord, scanner->firstWord);
+        }
+
+        if (!result->firstWord && scanner->firstWord) {
+            result->firstWord = strdup(scanner->firstWord);
+        }
+        strcpy(lastWord, pool_string(words, scanner->lastWord));
+        if (scanner->previousWord != NO_STRING) {
+            strcpy(previousWord, pool_string(words, scanner->previousWord));
+        }
+        hasLastWord = 1;
+    }
+
+    if (hasLastWord) {
+        result->lastWord = strdup(lastWord);
+    }
+    // collega l'ultima parola con la prima parola trovata
+    if (result->firstWord && result->lastWord) {
+        add_word(boundary, result->lastWord, result->firstWord);
+    }
+}
+
+/*
+ * analizza un file su più thread
+ *
+ * parametri
+ *   path: percorso del file da analizzare
+ *   threadCount: numero di thread da usare (0 per usare tutti i core disponibili)
+ *   result: riceve le partizioni della tabella finale e la prima/ultima parola
+ *
+ * ritorno
+ *   1 se l'analisi è stata eseguita, 0 se il file non è un file regolare mappabile
+ */
+int analyze_file_parallel(const char *path, int threadCount, ParallelAnalysis *result) {
+    memset(result, 0, sizeof(*result));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = (size_t)st.st_size;
+    const char *data = NULL;
+    if (size > 0) {
+        void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        madvise(mapped, size, MADV_WILLNEED);
+        data = mapped;
+    }
+    close(fd);
+
+    if (threadCount <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cores > 0 ? (int)cores : 1;
+    }
+    size_t chunkCount = (size_t)threadCount;
+    if (chunkCount > size / MIN_CHUNK_SIZE) {
+        chunkCount = size / MIN_CHUNK_SIZE;
+    }
+    if (chunkCount == 0) {
+        chunkCount = 1;
+    }
+
+    ChunkJob *chunks = calloc(chunkCount, sizeof(ChunkJob));
+    pthread_t *threads = malloc(chunkCount * sizeof(pthread_t));
+    if (!chunks || !threads) {
+        fprintf(stderr, "Memory allocation failed for analysis threads\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // divide il testo in blocchi che iniziano subito dopo un delimitatore
+    size_t start = 0;
+    for (size_t i = 0; i < chunkCount; i++) {
+        size_t end = (i == chunkCount - 1) ? size : size / chunkCount * (i + 1);
+        if (end < start) {
+            end = start;
+        }
+        while (end < size && !is_chunk_boundary(data[end - 1])) {
+            end++;
+        }
+        chunks[i].data = data + start;
+        chunks[i].size = end - start;
+        start = end;
+    }
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        if (pthread_create(&threads[i], NULL, analyze_chunk, &chunks[i]) != 0) {
+            fprintf(stderr, "Failed to create analysis thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < chunkCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    WordTable boundary;
+    init_word_table(&boundary, HASH_SIZE);
+    stitch_chunks(chunks, chunkCount, &boundary, result);
+
+    // unisce le tabelle: ogni thread costruisce una partizione disgiunta
+    result->partCount = chunkCount;
+    result->parts = calloc(chunkCount, sizeof(WordTable));
+    MergeJob *merges = calloc(chunkCount, sizeof(MergeJob));
+    if (!result->parts || !merges) {
+        fprintf(stderr, "Memory allocation failed for merge threads\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < chunkCount; i++) {
+        merges[i].chunks = chunks;
+        merges[i].chunkCount = chunkCount;
+        merges[i].boundary = &boundary;
+        merges[i].part = &result->parts[i];
+        merges[i].partIndex = i;
+        merges[i].partCount = chunkCount;
+        if (pthread_create(&threads[i], NULL, merge_part, &merges[i]) != 0) {
+            fprintf(stderr, "Failed to create merge thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (size_t i = 0; i < chunkCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        free_word_table(&chunks[i].table);
+        free(chunks[i].scanner.firstWord);
+    }
+    free_word_table(&boundary);
+    free(merges);
+    free(threads);
+    free(chunks);
+    if (data) {
+        munmap((void *)data, size);
+    }
+    return 1;
+}
+
+/*
+ * stampa tutte le partizioni della tabella in un file CSV
+ * le partizioni sono disgiunte, quindi ogni parola compare su una sola riga;
+ * dopo il primo errore di scrittura le partizioni rimaste non vengono scritte
+ *
+ * ritorno
+ *   0 se la scrittura è riuscita, -1 altrimenti
+ */
+int print_parallel_analysis(const ParallelAnalysis *result, FILE *file) {
+    for (size_t i = 0; i < result->partCount; i++) {
+        if (print_word_table(&result->parts[i], file, result->firstWord) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * stampa il csv dei conteggi esatti: intestazione e righe di tutte le partizioni
+ *
+ * ritorno
+ *   0 se la scrittura è riuscita, -1 altrimenti
+ */
+int print_parallel_counts(const ParallelAnalysis *result, FILE *file) {
+    print_counts_header(file, result->firstWord, result->lastWord);
+    for (size_t i = 0; i < result->partCount; i++) {
+        if (print_word_counts(&result->parts[i], file) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * somma le statistiche di memoria di tutte le partizioni
+ */
+void get_parallel_analysis_stats(const ParallelAnalysis *result, ArenaStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < result->partCount; i++) {
+        ArenaStats part;
+        get_word_table_stats(&result->parts[i], &part);
+        stats->reserved += part.reserved;
+        stats->used += part.used;
+        stats->slabCount += part.slabCount;
+    }
+}
+
+/*
+ * libera le risorse del risultato dell'analisi parallela
+ */
+void free_parallel_analysis(ParallelAnalysis *result) {
+    for (size_t i = 0; i < result->partCount; i++) {
+        free_word_table(&result->parts[i]);
+    }
+    free(result->parts);
+    free(result->firstWord);
+    free(result->lastWord);
+    memset(result, 0, sizeof(*result));
+}
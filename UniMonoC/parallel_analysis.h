@@ -0,0 +1,30 @@
+#ifndef PARALLEL_ANALYSIS_H
+#define PARALLEL_ANALYSIS_H
+
+#include <stdio.h>
+#include "text_analysis.h"
+
+// risultato dell'analisi parallela: la tabella finale è divisa in partizioni disgiunte
+typedef struct ParallelAnalysis {
+    WordTable *parts;       // ogni parola compare in una sola partizione
+    size_t partCount;
+    char *firstWord;
+    char *lastWord;
+} ParallelAnalysis;
+
+// analizza un file con più thread; ritorna 0 se il file non può essere mappato
+int analyze_file_parallel(const char *path, int threadCount, ParallelAnalysis *result);
+
+// stampa tutte le partizioni della tabella in un file CSV; ritorna 0 se la scrittura è riuscita
+int print_parallel_analysis(const ParallelAnalysis *result, FILE *file);
+
+// stampa tutte le partizioni con i conteggi esatti, precedute dall'intestazione; ritorna 0 se riuscita
+int print_parallel_counts(const ParallelAnalysis *result, FILE *file);
+
+// somma le statistiche di memoria di tutte le partizioni
+void get_parallel_analysis_stats(const ParallelAnalysis *result, ArenaStats *stats);
+
+// libera le risorse del risultato dell'analisi parallela
+void free_parallel_analysis(ParallelAnalysis *result);
+
+#endif // PARALLEL_ANALYSIS_H
@@ -0,0 +1,92 @@
+/*
+ * generatore pseudocasuale xoshiro256** di Blackman e Vigna
+ * sostituisce rand(), che ha uno stato globale e non può essere usato da più
+ * thread: ogni thread riceve un proprio flusso ottenuto dallo stesso seme con
+ * dei salti, quindi a parità di seme e di thread l'output è riproducibile
+ */
+#include "rng.h"
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * passo del generatore splitmix64, usato per espandere il seme nello stato
+ */
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * inizializza lo stato del generatore
+ * splitmix64 garantisce uno stato non nullo anche per semi piccoli o nulli
+ *
+ * parametri
+ *   rng: generatore da inizializzare
+ *   seed: seme
+ */
+void rng_seed(Rng *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        rng->state[i] = splitmix64(&seed);
+    }
+}
+
+/*
+ * avanza lo stato di 2^128 estrazioni
+ * equivale a 2^128 chiamate a rng_next, quindi i flussi ottenuti con salti
+ * successivi non si sovrappongono in pratica
+ */
+void rng_jump(Rng *rng) {
+    static const uint64_t jump[] = {
+        0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL
+    };
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (jump[i] & (1ULL << b)) {
+                s0 ^= rng->state[0];
+                s1 ^= rng->state[1];
+                s2 ^= rng->state[2];
+                s3 ^= rng->state[3];
+            }
+            rng_next(rng);
+        }
+    }
+    rng->state[0] = s0;
+    rng->state[1] = s1;
+    rng->state[2] = s2;
+    rng->state[3] = s3;
+}
+
+/*
+ * prepara flussi indipendenti: il flusso i è il seme iniziale avanzato di i salti
+ *
+ * parametri
+ *   seed: seme comune
+ *   streams: array di count generatori
+ *   count: numero di flussi
+ */
+void rng_split(uint64_t seed, Rng *streams, unsigned count) {
+    if (count == 0) {
+        return;
+    }
+    rng_seed(&streams[0], seed);
+    for (unsigned i = 1; i < count; i++) {
+        streams[i] = streams[i - 1];
+        rng_jump(&streams[i]);
+    }
+}
+
+/*
+ * restituisce un seme che cambia a ogni esecuzione
+ * combina l'ora in nanosecondi e il pid, come faceva srand(time(NULL)) ma
+ * senza ripetersi per due esecuzioni nello stesso secondo
+ */
+uint64_t rng_default_seed(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t seed = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+    seed ^= (uint64_t)getpid() << 32;
+    return splitmix64(&seed);
+}
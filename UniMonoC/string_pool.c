@@ -0,0 +1,189 @@
+/*
+ * insieme di stringhe internate
+ * ogni parola distinta viene copiata una sola volta nell'arena del proprietario
+ * e identificata da un id intero: i confronti tra parole diventano confronti tra
+ * interi e l'hash di ogni stringa viene calcolato una sola volta
+ */
+#include "string_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_INDEX_SIZE 16       // numero minimo di slot dell'indice
+#define MAX_LOAD_NUM 7          // fattore di carico massimo: 7/10
+#define MAX_LOAD_DEN 10
+
+/*
+ * rimescola i bit perché i bit bassi di djb2 sono poco distribuiti
+ */
+static inline unsigned long mix_hash(unsigned long hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdUL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/*
+ * funzione hash per le stringhe (djb2 con rimescolamento finale)
+ *
+ * parametri
+ *   str: stringa da cui generare l'hash
+ *
+ * ritorno
+ *   restituisce l'hash completo; l'indice usa i bit bassi come slot
+ */
+unsigned long hash_string(const char *str) {
+    unsigned long hash = 5381; // valore iniziale dell'hash
+    int c;
+    while ((c = *str++))
+        hash = ((hash << 5) + hash) + c;
+    return mix_hash(hash);
+}
+
+/*
+ * come hash_string, per una stringa di lunghezza nota non terminata da '\0'
+ */
+unsigned long hash_bytes(const char *str, size_t length) {
+    unsigned long hash = 5381;
+    for (size_t i = 0; i < length; i++)
+        hash = ((hash << 5) + hash) + str[i];
+    return mix_hash(hash);
+}
+
+/*
+ * inizializza l'insieme di stringhe
+ *
+ * parametri
+ *   pool: insieme da inizializzare
+ *   expected: numero di stringhe previsto, usato solo come stima iniziale
+ *   arena: allocatore in cui copiare i caratteri delle stringhe
+ */
+void init_string_pool(StringPool *pool, size_t expected, Arena *arena) {
+    memset(pool, 0, sizeof(*pool));
+    pool->arena = arena;
+    pool->indexSize = MIN_INDEX_SIZE;
+    while (pool->indexSize * MAX_LOAD_NUM < expected * MAX_LOAD_DEN) {
+        pool->indexSize <<= 1;
+    }
+    pool->index = calloc(pool->indexSize, sizeof(uint32_t));
+    if (!pool->index) {
+        fprintf(stderr, "Memory allocation failed for string pool index\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * raddoppia l'indice riutilizzando gli hash memorizzati
+ */
+static void grow_index(StringPool *pool) {
+    size_t size = pool->indexSize * 2;
+    uint32_t *index = calloc(size, sizeof(uint32_t));
+    if (!index) {
+        fprintf(stderr, "Memory allocation failed for string pool index\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t id = 0; id < pool->count; id++) {
+        size_t i = pool->hashes[id] & (size - 1);
+        while (index[i]) {
+            i = (i + 1) & (size - 1);
+        }
+        index[i] = id + 1;
+    }
+    free(pool->index);
+    pool->index = index;
+    pool->indexSize = size;
+}
+
+/*
+ * restituisce l'id di una stringa, aggiungendola se non è già presente
+ *
+ * parametri
+ *   pool: insieme di stringhe
+ *   str: stringa da internare
+ *
+ * ritorno
+ *   l'id della stringa, stabile per tutta la vita dell'insieme
+ */
+uint32_t intern_string(StringPool *pool, const char *str) {
+    return intern_string_length(pool, str, strlen(str));
+}
+
+/*
+ * come intern_string, per i primi length byte di str
+ * permette di internare un campo letto da un file mappato senza copiarlo prima
+ *
+ * parametri
+ *   pool: insieme di stringhe
+ *   str: caratteri della stringa, non necessariamente terminati da '\0'
+ *   length: numero di caratteri
+ *
+ * ritorno
+ *   l'id della stringa
+ */
+uint32_t intern_string_length(StringPool *pool, const char *str, size_t length) {
+    if (((size_t)pool->count + 1) * MAX_LOAD_DEN > pool->indexSize * MAX_LOAD_NUM) {
+        grow_index(pool);
+    }
+
+    unsigned long h = hash_bytes(str, length);
+    size_t mask = pool->indexSize - 1;
+    size_t i = h & mask;
+    while (pool->index[i]) {
+        uint32_t id = pool->index[i] - 1;
+        const char *stored = pool->strings[id];
+        if (pool->hashes[id] == h && strncmp(stored, str, length) == 0 && stored[length] == '\0') {
+            return id;
+        }
+        i = (i + 1) & mask;
+    }
+
+    if (pool->count == pool->capacity) {
+        uint32_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+        char **strings = realloc(pool->strings, capacity * sizeof(char *));
+        unsigned long *hashes = realloc(pool->hashes, capacity * sizeof(unsigned long));
+        if (!strings || !hashes) {
+            fprintf(stderr, "Memory allocation failed for string pool\n");
+            exit(EXIT_FAILURE);
+        }
+        pool->strings = strings;
+        pool->hashes = hashes;
+        pool->capacity = capacity;
+    }
+
+    uint32_t id = pool->count++;
+    pool->strings[id] = arena_strndup(pool->arena, str, length);
+    pool->hashes[id] = h;
+    pool->index[i] = id + 1;
+    return id;
+}
+
+/*
+ * cerca una stringa senza aggiungerla
+ *
+ * ritorno
+ *   l'id della stringa oppure NO_STRING se non è presente
+ */
+uint32_t find_string(const StringPool *pool, const char *str) {
+    unsigned long h = hash_string(str);
+    size_t mask = pool->indexSize - 1;
+    size_t i = h & mask;
+    while (pool->index[i]) {
+        uint32_t id = pool->index[i] - 1;
+        if (pool->hashes[id] == h && strcmp(pool->strings[id], str) == 0) {
+            return id;
+        }
+        i = (i + 1) & mask;
+    }
+    return NO_STRING;
+}
+
+/*
+ * libera gli indici dell'insieme
+ * i caratteri appartengono all'arena e vengono rilasciati insieme ad essa
+ */
+void free_string_pool(StringPool *pool) {
+    free(pool->strings);
+    free(pool->hashes);
+    free(pool->index);
+    memset(pool, 0, sizeof(*pool));
+}
@@ -0,0 +1,50 @@
+#ifndef STRING_POOL_H
+#define STRING_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+// id restituito quando una parola non è presente
+#define NO_STRING UINT32_MAX
+
+// insieme di stringhe internate: ogni stringa distinta è memorizzata una sola volta
+// e identificata da un id intero progressivo
+typedef struct StringPool {
+    char **strings;             // id -> stringa
+    unsigned long *hashes;      // id -> hash della stringa
+    uint32_t count;             // numero di stringhe internate
+    uint32_t capacity;          // spazio allocato per strings e hashes
+    uint32_t *index;            // indirizzamento aperto: slot -> id + 1, 0 se vuoto
+    size_t indexSize;           // numero di slot, sempre una potenza di due
+    Arena *arena;               // allocatore che contiene i caratteri delle stringhe
+} StringPool;
+
+// funzione hash usata per le stringhe internate
+unsigned long hash_string(const char *str);
+
+// hash dei primi length byte di str, uguale a hash_string sulla stessa stringa
+unsigned long hash_bytes(const char *str, size_t length);
+
+// inizializza l'insieme con una stima del numero di stringhe
+// i caratteri sono copiati in arena, che deve vivere almeno quanto l'insieme
+void init_string_pool(StringPool *pool, size_t expected, Arena *arena);
+
+// restituisce l'id della stringa, aggiungendola se non è già presente
+uint32_t intern_string(StringPool *pool, const char *str);
+
+// come intern_string, per una stringa di length byte non terminata da '\0'
+uint32_t intern_string_length(StringPool *pool, const char *str, size_t length);
+
+// cerca una stringa senza aggiungerla; restituisce NO_STRING se non esiste
+uint32_t find_string(const StringPool *pool, const char *str);
+
+// restituisce la stringa con un dato id
+static inline const char *pool_string(const StringPool *pool, uint32_t id) {
+    return pool->strings[id];
+}
+
+// libera gli indici dell'insieme; i caratteri restano all'arena
+void free_string_pool(StringPool *pool);
+
+#endif // STRING_POOL_H
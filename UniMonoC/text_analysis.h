@@ -2,28 +2,49 @@
 #define TEXT_ANALYSIS_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include "arena.h"
+#include "string_pool.h"
 
-// definisci la dimensione della tabella hash per la tabella delle parole
+// numero di parole previsto per la tabella delle parole (cresce da sola)
 #define HASH_SIZE 997
 
-// struttura per memorizzare una parola e la sua frequenza
+// dimensione dei blocchi dell'arena che contiene parole e successori
+#ifndef WORD_TABLE_SLAB_SIZE
+#define WORD_TABLE_SLAB_SIZE (1024 * 1024)
+#endif
+
+// prima cella del csv dei conteggi esatti
+#define COUNTS_HEADER "#counts"
+
+// numero di successori oltre il quale una parola usa un indice hash
+#define SUCCESSOR_INDEX_THRESHOLD 16
+
+// struttura per memorizzare una parola successiva e la sua frequenza
 typedef struct SuccessorNode {
-    char *word;
-    int frequency;
+    uint32_t word;              // id della parola successiva nella tabella
+    uint32_t frequency;         // occorrenze esatte della coppia
     float relative_frequency;
-    struct SuccessorNode *next;
 } SuccessorNode;
 
+// successori di una parola; il nodo della parola con id i è nodes[i]
+// i successori sono un array contiguo; oltre SUCCESSOR_INDEX_THRESHOLD
+// elementi vengono cercati tramite successorIndex invece che scorrendo l'array
 typedef struct WordNode {
-    char *word;
     SuccessorNode *successors;
-    struct WordNode *next;
+    uint32_t successorCount;
+    uint32_t successorCapacity;
+    uint32_t *successorIndex;   // slot -> posizione + 1, 0 se vuoto; NULL sotto soglia
+    uint32_t indexSize;         // numero di slot dell'indice, potenza di due
 } WordNode;
 
 // struttura per la tabella delle parole
 typedef struct WordTable {
-    WordNode **buckets;
-    size_t size;
+    Arena arena;                // memoria di parole e successori
+    StringPool words;           // parole internate: ogni parola ha un id
+    WordNode *nodes;            // nodi indicizzati per id
+    size_t size;                // numero di nodi validi
+    size_t capacity;            // spazio allocato per i nodi
 } WordTable;
 
 // inizializza la tabella delle parole
@@ -32,16 +53,63 @@ void init_word_table(WordTable *table, size_t size);
 // aggiunge una parola alla tabella
 void add_word(WordTable *table, const char *word, const char *next_word);
 
+// aggiunge una coppia di parole con un dato numero di occorrenze
+void add_word_count(WordTable *table, const char *word, const char *next_word, uint32_t count);
+
+// restituisce l'id di una parola, aggiungendola se non esiste
+uint32_t word_table_intern(WordTable *table, const char *word);
+
+// aggiunge una coppia di parole già internate
+void add_word_ids(WordTable *table, uint32_t word, uint32_t next_word, uint32_t count);
+
 // libera la memoria utilizzata dalla tabella delle parole
 void free_word_table(WordTable *table);
 
-// stampa la tabella delle parole in un file CSV
-void print_word_table(const WordTable *table, FILE *file, const char *firstWord);
+// legge le statistiche di memoria della tabella
+void get_word_table_stats(const WordTable *table, ArenaStats *stats);
+
+// stampa la tabella delle parole in un file CSV; ritorna 0 se la scrittura è riuscita
+int print_word_table(const WordTable *table, FILE *file, const char *firstWord);
+
+// scrive l'intestazione del csv dei conteggi con la prima e l'ultima parola del testo
+void print_counts_header(FILE *file, const char *firstWord, const char *lastWord);
+
+// stampa la tabella delle parole con i conteggi esatti in un file CSV; ritorna 0 se la scrittura è riuscita
+int print_word_counts(const WordTable *table, FILE *file);
+
+// stato del tokenizzatore incrementale: permette di analizzare il testo a blocchi
+typedef struct TextScanner {
+    WordTable *table;
+    void (*emitPair)(void *context, uint32_t word, uint32_t next); // se impostata riceve le coppie al posto della tabella
+    void *emitContext;
+    char *firstWord;                // prima parola trovata (da liberare con free)
+    uint32_t lastWord;              // id dell'ultimo token, parola o punteggiatura
+    uint32_t previousWord;          // id dell'ultima parola, esclusa la punteggiatura
+    char word[256];                 // parola in costruzione
+    int idx;
+    int foldWord;                   // la parola in costruzione contiene byte UTF-8 non ASCII
+    char pending[4];                // sequenza UTF-8 non ancora completa, spezzata tra due blocchi
+    int pendingLength;              // byte già ricevuti della sequenza
+    int pendingExpected;            // byte totali della sequenza
+    size_t leadingPunctuation[3];   // '.', '?' e '!' trovati prima della prima parola
+} TextScanner;
+
+// inizializza il tokenizzatore
+void init_text_scanner(TextScanner *scanner, WordTable *table);
+
+// analizza un blocco di testo proseguendo dallo stato precedente
+void scan_text(TextScanner *scanner, const char *data, size_t size);
+
+// registra l'eventuale parola rimasta in sospeso alla fine del testo
+void finish_text_scanner(TextScanner *scanner);
 
 // funzione per analizzare il testo e popolare la tabella delle parole
 void analyze_text(FILE *inputFile, WordTable *table, char **firstWord, char **lastWord);
 
-char* find_first_word(FILE *file);
-char* find_last_token(FILE *file);
+// prosegue l'analisi di una tabella già popolata con il testo di un nuovo file
+void continue_analysis(FILE *inputFile, WordTable *table, char **firstWord, char **lastWord);
+
+// analizza un testo già in memoria (ad esempio un file mappato) in un'unica passata
+void analyze_buffer(const char *data, size_t size, WordTable *table, char **firstWord, char **lastWord);
 
 #endif // TEXT_ANALYSIS_H
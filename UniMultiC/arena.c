@@ -0,0 +1,191 @@
+/*
+ * allocatore a blocchi (arena)
+ * le strutture che vivono quanto il modello vengono ritagliate da grandi blocchi
+ * contigui: un'allocazione costa un incremento di puntatore e la liberazione
+ * costa una free per blocco invece di una per nodo
+ */
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN (sizeof(void *)) // sufficiente per puntatori, interi e float del modello
+
+/*
+ * inizializza l'allocatore senza riservare memoria
+ *
+ * parametri
+ *   arena: allocatore da inizializzare
+ *   slabSize: dimensione di un blocco; le richieste più grandi ricevono un blocco dedicato
+ */
+void init_arena(Arena *arena, size_t slabSize) {
+    memset(arena, 0, sizeof(*arena));
+    arena->slabSize = slabSize;
+}
+
+/*
+ * aggiunge un blocco capace di contenere almeno size byte
+ * le richieste più grandi di un blocco normale ricevono un blocco dedicato, già
+ * tutto assegnato e inserito dietro al blocco corrente: così lo spazio rimasto
+ * nel blocco corrente non viene abbandonato e resta per le allocazioni successive
+ *
+ * ritorno
+ *   il blocco aggiunto
+ */
+static ArenaSlab *add_slab(Arena *arena, size_t size) {
+    int dedicated = size > arena->slabSize;
+    size_t slabSize = dedicated ? size : arena->slabSize;
+    ArenaSlab *slab = malloc(sizeof(ArenaSlab) + slabSize);
+    if (!slab) {
+        fprintf(stderr, "Memory allocation failed for arena slab\n");
+        exit(EXIT_FAILURE);
+    }
+    slab->size = slabSize;
+    slab->used = dedicated ? size : 0;
+    if (dedicated && arena->slabs) {
+        slab->next = arena->slabs->next;
+        arena->slabs->next = slab;
+    } else {
+        slab->next = arena->slabs;
+        arena->slabs = slab;
+    }
+    arena->reserved += sizeof(ArenaSlab) + slabSize;
+    arena->slabCount++;
+    return slab;
+}
+
+/*
+ * alloca size byte dall'allocatore
+ *
+ * parametri
+ *   arena: allocatore
+ *   size: numero di byte richiesti
+ *
+ * ritorno
+ *   puntatore alla memoria, allineato come un puntatore; termina il programma
+ *   se la memoria è esaurita, come le altre allocazioni del progetto
+ */
+void *arena_alloc(Arena *arena, size_t size) {
+    // le stringhe possono aver lasciato il blocco disallineato
+    arena->used += size;
+    if (size > arena->slabSize) {
+        return add_slab(arena, size)->data;
+    }
+    size_t offset = arena->slabs ? (arena->slabs->used + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1) : 0;
+    if (!arena->slabs || offset + size > arena->slabs->size) {
+        add_slab(arena, size);
+        offset = 0;
+    }
+    void *ptr = (char *)arena->slabs->data + offset;
+    arena->slabs->used = offset + size;
+    return ptr;
+}
+
+/*
+ * calcola la classe di dimensione di un blocco
+ */
+static int block_class(size_t size) {
+    int c = 0;
+    while (((size_t)1 << c) < size) {
+        c++;
+    }
+    return c;
+}
+
+/*
+ * alloca un blocco per un array che può crescere
+ * i blocchi hanno dimensione potenza di due: quando un array raddoppia, il blocco
+ * vecchio viene restituito con arena_release_block e riusato dal prossimo array
+ * della stessa classe, così la crescita non spreca memoria dell'arena
+ *
+ * parametri
+ *   arena: allocatore
+ *   size: dimensione del blocco, potenza di due di almeno sizeof(void *)
+ *
+ * ritorno
+ *   puntatore al blocco
+ */
+void *arena_alloc_block(Arena *arena, size_t size) {
+    int c = block_class(size);
+    void *block = arena->freeBlocks[c];
+    if (block) {
+        arena->freeBlocks[c] = *(void **)block;
+        arena->used += size;
+        return block;
+    }
+    return arena_alloc(arena, size);
+}
+
+/*
+ * restituisce un blocco all'allocatore perché venga riusato
+ *
+ * parametri
+ *   arena: allocatore
+ *   block: blocco ottenuto da arena_alloc_block
+ *   size: dimensione usata per allocarlo
+ */
+void arena_release_block(Arena *arena, void *block, size_t size) {
+    int c = block_class(size);
+    *(void **)block = arena->freeBlocks[c];
+    arena->freeBlocks[c] = block;
+    arena->used -= size;
+}
+
+/*
+ * copia una stringa nell'allocatore
+ * le stringhe non richiedono allineamento, quindi sono impacchettate una dopo l'altra
+ *
+ * parametri
+ *   arena: allocatore
+ *   str: caratteri da copiare
+ *   length: numero di caratteri, escluso il terminatore
+ *
+ * ritorno
+ *   copia della stringa terminata da '\0'
+ */
+char *arena_strndup(Arena *arena, const char *str, size_t length) {
+    char *copy;
+    if (length + 1 > arena->slabSize) {
+        copy = (char *)add_slab(arena, length + 1)->data;
+    } else {
+        if (!arena->slabs || arena->slabs->used + length + 1 > arena->slabs->size) {
+            add_slab(arena, length + 1);
+        }
+        copy = (char *)arena->slabs->data + arena->slabs->used;
+        arena->slabs->used += length + 1;
+    }
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+    arena->used += length + 1;
+    return copy;
+}
+
+/*
+ * legge le statistiche dell'allocatore
+ *
+ * parametri
+ *   arena: allocatore
+ *   stats: riceve byte riservati, byte usati e numero di blocchi
+ */
+void get_arena_stats(const Arena *arena, ArenaStats *stats) {
+    stats->reserved = arena->reserved;
+    stats->used = arena->used;
+    stats->slabCount = arena->slabCount;
+}
+
+/*
+ * libera tutti i blocchi: il costo dipende solo dal numero di blocchi
+ */
+void free_arena(Arena *arena) {
+    ArenaSlab *slab = arena->slabs;
+    while (slab) {
+        ArenaSlab *next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    memset(arena->freeBlocks, 0, sizeof(arena->freeBlocks));
+    arena->slabs = NULL;
+    arena->reserved = 0;
+    arena->used = 0;
+    arena->slabCount = 0;
+}
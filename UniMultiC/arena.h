@@ -0,0 +1,56 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// numero di classi di dimensione per i blocchi riciclabili (potenze di due)
+#define ARENA_BLOCK_CLASSES 48
+
+// blocco di memoria da cui vengono ritagliate le allocazioni
+typedef struct ArenaSlab {
+    struct ArenaSlab *next;
+    size_t size;                // byte disponibili in data
+    size_t used;                // byte già assegnati
+    max_align_t data[];
+} ArenaSlab;
+
+// allocatore a blocchi: le allocazioni non si liberano singolarmente,
+// tutta la memoria viene rilasciata insieme con free_arena
+typedef struct Arena {
+    ArenaSlab *slabs;           // blocco corrente in testa alla lista
+    size_t slabSize;            // dimensione di un blocco normale
+    size_t reserved;            // byte richiesti al sistema
+    size_t used;                // byte assegnati alle allocazioni
+    size_t slabCount;
+    void *freeBlocks[ARENA_BLOCK_CLASSES]; // blocchi restituiti, per classe di dimensione
+} Arena;
+
+// statistiche dell'allocatore, utili a dimensionare i blocchi
+typedef struct ArenaStats {
+    size_t reserved;
+    size_t used;
+    size_t slabCount;
+} ArenaStats;
+
+// inizializza l'allocatore con una data dimensione dei blocchi
+void init_arena(Arena *arena, size_t slabSize);
+
+// alloca size byte allineati come un puntatore
+void *arena_alloc(Arena *arena, size_t size);
+
+// alloca un blocco di dimensione potenza di due, riusando quelli restituiti
+void *arena_alloc_block(Arena *arena, size_t size);
+
+// restituisce un blocco ottenuto con arena_alloc_block perché venga riusato
+void arena_release_block(Arena *arena, void *block, size_t size);
+
+// copia una stringa di length caratteri nell'allocatore
+char *arena_strndup(Arena *arena, const char *str, size_t length);
+
+// legge le statistiche dell'allocatore
+void get_arena_stats(const Arena *arena, ArenaStats *stats);
+
+// libera tutti i blocchi dell'allocatore
+void free_arena(Arena *arena);
+
+#endif // ARENA_H
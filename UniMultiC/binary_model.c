@@ -0,0 +1,384 @@
+/*
+ * formato binario del modello di generazione
+ * il file contiene un'intestazione seguita dagli stessi array di GenerationModel,
+ * già indicizzati e con le tabelle alias precalcolate: il generatore lo mappa in
+ * memoria e lo usa senza nessuna lettura o conversione. I valori sono salvati
+ * nell'ordine dei byte della macchina che ha eseguito l'analisi
+ */
+#include "binary_model.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SECTION_ALIGN 8 // allineamento di ogni sezione del file
+
+/*
+ * arrotonda una posizione al successivo inizio di sezione
+ */
+static uint64_t align_section(uint64_t offset) {
+    return (offset + SECTION_ALIGN - 1) & ~(uint64_t)(SECTION_ALIGN - 1);
+}
+
+/*
+ * calcola la disposizione delle sezioni del file per un modello
+ *
+ * parametri
+ *   model: modello da salvare
+ *   header: intestazione da compilare
+ */
+static void layout_binary_model(const GenerationModel *model, BinaryModelHeader *header) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, BINARY_MODEL_MAGIC, sizeof(header->magic));
+    header->version = BINARY_MODEL_VERSION;
+    header->headerSize = sizeof(BinaryModelHeader);
+    header->wordCount = model->wordCount;
+    header->successorTotal = model->successorTotal;
+    header->indexSize = model->indexSize;
+    header->firstWord = model->firstWord;
+    header->lastWord = model->lastWord;
+
+    uint64_t dataSize = 0;
+    if (model->wordCount > 0) {
+        const char *last = model_word(model, model->wordCount - 1);
+        dataSize = (uint64_t)(last - model->wordData) + strlen(last) + 1;
+    }
+    header->wordDataSize = dataSize;
+
+    uint64_t total = model->successorTotal;
+    uint64_t offset = align_section(sizeof(BinaryModelHeader));
+    header->wordDataOffset = offset;
+    offset = align_section(offset + dataSize);
+    header->wordOffsetsOffset = offset;
+    offset = align_section(offset + (uint64_t)model->wordCount * sizeof(uint32_t));
+    header->wordIndexOffset = offset;
+    offset = align_section(offset + (uint64_t)model->indexSize * sizeof(uint32_t));
+    header->successorStartOffset = offset;
+    offset = align_section(offset + ((uint64_t)model->wordCount + 1) * sizeof(uint32_t));
+    header->successorsOffset = offset;
+    offset = align_section(offset + total * sizeof(uint32_t));
+    header->weightsOffset = offset;
+    offset = align_section(offset + total * sizeof(uint32_t));
+    header->aliasThresholdOffset = offset;
+    offset = align_section(offset + total * sizeof(uint32_t));
+    header->aliasIndexOffset = offset;
+    offset = align_section(offset + total * sizeof(uint32_t));
+    header->aliasCapacityOffset = offset;
+    offset = align_section(offset + (uint64_t)model->wordCount * sizeof(uint32_t));
+    header->totalSize = offset;
+}
+
+/*
+ * costruisce il modello dalle tabelle prodotte dall'analisi
+ * le parole di tutte le tabelle vengono unite in un unico vocabolario e ogni
+ * coppia usa come peso il proprio conteggio, senza passare dalle frequenze
+ * relative arrotondate del csv
+ *
+ * parametri
+ *   tables: tabelle da unire (ad esempio le partizioni dell'analisi parallela)
+ *   tableCount: numero di tabelle
+ *   firstWord: prima parola del testo, può essere NULL
+ *   lastWord: ultimo token del testo, può essere NULL
+ *   model: modello da costruire
+ */
+void build_model_from_tables(const WordTable *tables, size_t tableCount,
+                             const char *firstWord, const char *lastWord, GenerationModel *model) {
+    init_generation_model(model);
+
+    // vocabolario comune: ogni tabella ottiene una mappa dai suoi id a quelli globali
+    size_t expected = 0;
+    for (size_t t = 0; t < tableCount; t++) {
+        expected += tables[t].words.count;
+    }
+    Arena scratch;
+    StringPool words;
+    init_arena(&scratch, MODEL_SLAB_SIZE);
+    init_string_pool(&words, expected, &scratch);
+
+    uint32_t **maps = malloc((tableCount + 1) * sizeof(uint32_t *));
+    if (!maps) {
+        fprintf(stderr, "Memory allocation failed for binary model\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t t = 0; t < tableCount; t++) {
+        const StringPool *source = &tables[t].words;
+        maps[t] = malloc((source->count + 1) * sizeof(uint32_t));
+        if (!maps[t]) {
+            fprintf(stderr, "Memory allocation failed for binary model\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t id = 0; id < source->count; id++) {
+            maps[t][id] = intern_string(&words, pool_string(source, id));
+        }
+    }
+    set_model_words(model, &words);
+    if (firstWord) {
+        model->firstWord = find_string(&words, firstWord);
+    }
+    if (lastWord) {
+        model->lastWord = find_string(&words, lastWord);
+    }
+    free_string_pool(&words);
+    free_arena(&scratch);
+
+    // conta i successori di ogni parola e calcola l'inizio di ciascun blocco
+    uint32_t wordCount = model->wordCount;
+    uint32_t *start = arena_alloc(&model->arena, (wordCount + 1) * sizeof(uint32_t));
+    memset(start, 0, (wordCount + 1) * sizeof(uint32_t));
+    for (size_t t = 0; t < tableCount; t++) {
+        for (size_t id = 0; id < tables[t].size; id++) {
+            start[maps[t][id] + 1] += tables[t].nodes[id].successorCount;
+        }
+    }
+    for (uint32_t id = 0; id < wordCount; id++) {
+        start[id + 1] += start[id];
+    }
+
+    uint32_t total = start[wordCount];
+    uint32_t *successors = arena_alloc(&model->arena, (total + 1) * sizeof(uint32_t));
+    uint32_t *weights = arena_alloc(&model->arena, (total + 1) * sizeof(uint32_t));
+
+    // copia le coppie nel blocco della parola corrente, traducendo gli id
+    uint32_t *fill = malloc((wordCount + 1) * sizeof(uint32_t));
+    if (!fill) {
+        fprintf(stderr, "Memory allocation failed for binary model\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(fill, start, (wordCount + 1) * sizeof(uint32_t));
+    for (size_t t = 0; t < tableCount; t++) {
+        for (size_t id = 0; id < tables[t].size; id++) {
+            const WordNode *node = &tables[t].nodes[id];
+            uint32_t *position = &fill[maps[t][id]];
+            for (uint32_t i = 0; i < node->successorCount; i++) {
+                successors[*position] = maps[t][node->successors[i].word];
+                weights[*position] = node->successors[i].frequency;
+                (*position)++;
+            }
+        }
+        free(maps[t]);
+    }
+    free(maps);
+    free(fill);
+
+    model->successorTotal = total;
+    model->successorStart = start;
+    model->successors = successors;
+    model->weights = weights;
+    build_alias_tables(model);
+}
+
+/*
+ * restituisce la dimensione in byte del modello nel formato binario
+ */
+size_t binary_model_size(const GenerationModel *model) {
+    BinaryModelHeader header;
+    layout_binary_model(model, &header);
+    return (size_t)header.totalSize;
+}
+
+/*
+ * copia il modello nel formato binario in un buffer già allocato
+ * gli spazi di allineamento tra le sezioni vengono azzerati
+ *
+ * parametri
+ *   model: modello da salvare
+ *   destination: buffer di almeno binary_model_size(model) byte
+ */
+void store_binary_model(const GenerationModel *model, void *destination) {
+    BinaryModelHeader header;
+    layout_binary_model(model, &header);
+
+    char *out = destination;
+    uint32_t total = model->successorTotal;
+    memset(out, 0, (size_t)header.totalSize);
+    memcpy(out, &header, sizeof(header));
+    memcpy(out + header.wordDataOffset, model->wordData, (size_t)header.wordDataSize);
+    memcpy(out + header.wordOffsetsOffset, model->wordOffsets, model->wordCount * sizeof(uint32_t));
+    memcpy(out + header.wordIndexOffset, model->wordIndex, model->indexSize * sizeof(uint32_t));
+    memcpy(out + header.successorStartOffset, model->successorStart, (model->wordCount + 1) * sizeof(uint32_t));
+    memcpy(out + header.successorsOffset, model->successors, total * sizeof(uint32_t));
+    memcpy(out + header.weightsOffset, model->weights, total * sizeof(uint32_t));
+    memcpy(out + header.aliasThresholdOffset, model->aliasThreshold, total * sizeof(uint32_t));
+    memcpy(out + header.aliasIndexOffset, model->aliasIndex, total * sizeof(uint32_t));
+    memcpy(out + header.aliasCapacityOffset, model->aliasCapacity, model->wordCount * sizeof(uint32_t));
+}
+
+/*
+ * scrive una sezione del file seguita dai byte di allineamento
+ *
+ * ritorno
+ *   1 se la scrittura è riuscita, 0 altrimenti
+ */
+static int write_section(FILE *file, const void *data, uint64_t size, uint64_t *offset, uint64_t next) {
+    static const char padding[SECTION_ALIGN] = {0};
+    if (size > 0 && fwrite(data, 1, (size_t)size, file) != size) {
+        return 0;
+    }
+    *offset += size;
+    size_t gap = (size_t)(next - *offset);
+    if (gap > 0 && fwrite(padding, 1, gap, file) != gap) {
+        return 0;
+    }
+    *offset = next;
+    return 1;
+}
+
+/*
+ * scrive il modello nel formato binario, una sezione dopo l'altra
+ *
+ * parametri
+ *   model: modello da salvare
+ *   file: file di output aperto in scrittura
+ *
+ * ritorno
+ *   1 se la scrittura è riuscita, 0 altrimenti
+ */
+int write_binary_model(const GenerationModel *model, FILE *file) {
+    BinaryModelHeader header;
+    layout_binary_model(model, &header);
+
+    uint64_t total = model->successorTotal;
+    uint64_t offset = 0;
+    return write_section(file, &header, sizeof(header), &offset, header.wordDataOffset)
+        && write_section(file, model->wordData, header.wordDataSize, &offset, header.wordOffsetsOffset)
+        && write_section(file, model->wordOffsets, (uint64_t)model->wordCount * sizeof(uint32_t),
+                         &offset, header.wordIndexOffset)
+        && write_section(file, model->wordIndex, (uint64_t)model->indexSize * sizeof(uint32_t),
+                         &offset, header.successorStartOffset)
+        && write_section(file, model->successorStart, ((uint64_t)model->wordCount + 1) * sizeof(uint32_t),
+                         &offset, header.successorsOffset)
+        && write_section(file, model->successors, total * sizeof(uint32_t), &offset, header.weightsOffset)
+        && write_section(file, model->weights, total * sizeof(uint32_t), &offset, header.aliasThresholdOffset)
+        && write_section(file, model->aliasThreshold, total * sizeof(uint32_t), &offset, header.aliasIndexOffset)
+        && write_section(file, model->aliasIndex, total * sizeof(uint32_t), &offset, header.aliasCapacityOffset)
+        && write_section(file, model->aliasCapacity, (uint64_t)model->wordCount * sizeof(uint32_t),
+                         &offset, header.totalSize)
+        && fflush(file) == 0;
+}
+
+/*
+ * controlla che una sezione sia allineata e contenuta nell'immagine
+ */
+static int valid_section(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset % SECTION_ALIGN == 0 && offset <= size && length <= size - offset;
+}
+
+/*
+ * collega il modello a un'immagine binaria in memoria
+ * gli array del modello puntano direttamente dentro l'immagine, che deve restare
+ * valida finché il modello è in uso; vengono controllati solo l'intestazione e i
+ * limiti delle sezioni, in tempo costante. La versione viene controllata subito
+ * dopo il magic: un modello di un'altra versione ha un'intestazione diversa e
+ * non va confuso con un file danneggiato
+ *
+ * parametri
+ *   data: inizio dell'immagine, allineato a 8 byte
+ *   size: dimensione dell'immagine
+ *   model: modello da inizializzare
+ *
+ * ritorno
+ *   1 se l'immagine è valida, BINARY_MODEL_UNSUPPORTED se è di un'altra versione
+ *   del formato, 0 altrimenti
+ */
+int attach_binary_model(const void *data, size_t size, GenerationModel *model) {
+    const BinaryModelHeader *header = data;
+    if (size < offsetof(BinaryModelHeader, headerSize)
+        || memcmp(header->magic, BINARY_MODEL_MAGIC, sizeof(header->magic)) != 0) {
+        return 0;
+    }
+    if (header->version != BINARY_MODEL_VERSION) {
+        return BINARY_MODEL_UNSUPPORTED;
+    }
+    if (size < sizeof(BinaryModelHeader) || header->headerSize != sizeof(BinaryModelHeader)
+        || header->totalSize > size) {
+        return 0;
+    }
+
+    uint64_t total = header->successorTotal;
+    uint64_t words = header->wordCount;
+    uint64_t limit = header->totalSize;
+    if (header->indexSize == 0 || (header->indexSize & (header->indexSize - 1)) != 0
+        || header->indexSize <= words
+        || !valid_section(header->wordDataOffset, header->wordDataSize, limit)
+        || !valid_section(header->wordOffsetsOffset, words * sizeof(uint32_t), limit)
+        || !valid_section(header->wordIndexOffset, (uint64_t)header->indexSize * sizeof(uint32_t), limit)
+        || !valid_section(header->successorStartOffset, (words + 1) * sizeof(uint32_t), limit)
+        || !valid_section(header->successorsOffset, total * sizeof(uint32_t), limit)
+        || !valid_section(header->weightsOffset, total * sizeof(uint32_t), limit)
+        || !valid_section(header->aliasThresholdOffset, total * sizeof(uint32_t), limit)
+        || !valid_section(header->aliasIndexOffset, total * sizeof(uint32_t), limit)
+        || !valid_section(header->aliasCapacityOffset, words * sizeof(uint32_t), limit)) {
+        return 0;
+    }
+
+    const char *base = data;
+    memset(model, 0, sizeof(*model));
+    model->wordCount = header->wordCount;
+    model->successorTotal = header->successorTotal;
+    model->wordData = base + header->wordDataOffset;
+    model->wordOffsets = (const uint32_t *)(base + header->wordOffsetsOffset);
+    model->wordIndex = (const uint32_t *)(base + header->wordIndexOffset);
+    model->indexSize = header->indexSize;
+    model->successorStart = (const uint32_t *)(base + header->successorStartOffset);
+    model->successors = (const uint32_t *)(base + header->successorsOffset);
+    model->weights = (const uint32_t *)(base + header->weightsOffset);
+    model->aliasThreshold = (const uint32_t *)(base + header->aliasThresholdOffset);
+    model->aliasIndex = (const uint32_t *)(base + header->aliasIndexOffset);
+    model->aliasCapacity = (const uint32_t *)(base + header->aliasCapacityOffset);
+    model->firstWord = header->firstWord;
+    model->lastWord = header->lastWord;
+    return 1;
+}
+
+/*
+ * carica un modello binario mappando il file in memoria in sola lettura
+ *
+ * parametri
+ *   path: percorso del file
+ *   model: modello da inizializzare; il file resta mappato fino a free_generation_model
+ *   version: riceve la versione del formato scritta nel file, se il file è un modello binario
+ *
+ * ritorno
+ *   1 se il modello è stato caricato, 0 se il file non è un modello binario
+ *   (ad esempio un csv), -1 se il file è un modello binario danneggiato,
+ *   BINARY_MODEL_UNSUPPORTED se è stato scritto con un'altra versione del formato
+ */
+int load_binary_model(const char *path, GenerationModel *model, uint32_t *version) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+
+    struct stat st;
+    char magic[sizeof(((BinaryModelHeader *)0)->magic)];
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)
+        || pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic)
+        || memcmp(magic, BINARY_MODEL_MAGIC, sizeof(magic)) != 0) {
+        close(fd);
+        return 0;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size < offsetof(BinaryModelHeader, headerSize)) {
+        close(fd);
+        return -1; // intestazione troncata prima della versione
+    }
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // la mappatura resta valida anche dopo la chiusura
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    madvise(data, size, MADV_RANDOM); // la generazione salta da una parola all'altra
+
+    *version = ((const BinaryModelHeader *)data)->version;
+    int attached = attach_binary_model(data, size, model);
+    if (attached != 1) {
+        munmap(data, size);
+        return attached == BINARY_MODEL_UNSUPPORTED ? BINARY_MODEL_UNSUPPORTED : -1;
+    }
+    model->mapping = data;
+    model->mappingSize = size;
+    return 1;
+}
@@ -0,0 +1,61 @@
+#ifndef BINARY_MODEL_H
+#define BINARY_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "generation_model.h"
+#include "text_analysis.h"
+
+#define BINARY_MODEL_MAGIC "WFGMODL"  // 8 byte compreso il terminatore
+#define BINARY_MODEL_VERSION 2
+#define BINARY_MODEL_UNSUPPORTED -2   // modello binario scritto con un'altra versione del formato
+
+// intestazione del formato binario del modello
+// ogni sezione inizia a un offset multiplo di 8 dall'inizio del file, così
+// il file mappato in memoria può essere usato direttamente come GenerationModel
+typedef struct BinaryModelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(BinaryModelHeader), per riconoscere file di altre build
+    uint32_t wordCount;
+    uint32_t successorTotal;
+    uint32_t indexSize;
+    uint32_t firstWord;         // NO_STRING se il testo era vuoto
+    uint32_t lastWord;
+    uint32_t reserved;
+    uint64_t wordDataSize;
+    uint64_t wordDataOffset;        // char[wordDataSize]
+    uint64_t wordOffsetsOffset;     // uint32_t[wordCount]
+    uint64_t wordIndexOffset;       // uint32_t[indexSize]
+    uint64_t successorStartOffset;  // uint32_t[wordCount + 1]
+    uint64_t successorsOffset;      // uint32_t[successorTotal]
+    uint64_t weightsOffset;         // uint32_t[successorTotal]
+    uint64_t aliasThresholdOffset;  // uint32_t[successorTotal]
+    uint64_t aliasIndexOffset;      // uint32_t[successorTotal]
+    uint64_t aliasCapacityOffset;   // uint32_t[wordCount]
+    uint64_t totalSize;
+} BinaryModelHeader;
+
+// costruisce il modello dalle tabelle dell'analisi usando i conteggi come pesi
+void build_model_from_tables(const WordTable *tables, size_t tableCount,
+                             const char *firstWord, const char *lastWord, GenerationModel *model);
+
+// dimensione in byte del modello nel formato binario
+size_t binary_model_size(const GenerationModel *model);
+
+// copia il modello nel formato binario in un buffer di binary_model_size byte
+void store_binary_model(const GenerationModel *model, void *destination);
+
+// scrive il modello nel formato binario; ritorna 0 in caso di errore di scrittura
+int write_binary_model(const GenerationModel *model, FILE *file);
+
+// collega il modello a un'immagine binaria già in memoria, senza copiarla
+// ritorna 1 se valida, 0 se danneggiata, BINARY_MODEL_UNSUPPORTED se di un'altra versione
+int attach_binary_model(const void *data, size_t size, GenerationModel *model);
+
+// mappa un file binario; ritorna 1 se caricato, 0 se non è un modello binario, -1 se è danneggiato,
+// BINARY_MODEL_UNSUPPORTED se è di un'altra versione del formato, letta in version
+int load_binary_model(const char *path, GenerationModel *model, uint32_t *version);
+
+#endif // BINARY_MODEL_H
@@ -0,0 +1,100 @@
+#ifndef GENERATION_MODEL_H
+#define GENERATION_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "arena.h"
+#include "rng.h"
+#include "string_pool.h"
+
+#define MODEL_SLAB_SIZE (1024 * 1024)  // dimensione dei blocchi dell'arena del modello
+
+// modello indicizzato per la generazione del testo
+// le parole sono identificate da un id; i successori della parola id occupano
+// il blocco contiguo successors[successorStart[id] .. successorStart[id + 1])
+// e ogni blocco ha la sua tabella alias per l'estrazione in tempo costante
+typedef struct GenerationModel {
+    uint32_t wordCount;
+    uint32_t successorTotal;
+    const char *wordData;           // parole terminate da '\0', una dopo l'altra
+    const uint32_t *wordOffsets;    // id -> posizione della parola in wordData
+    const uint32_t *wordIndex;      // indirizzamento aperto: slot -> id + 1, 0 se vuoto
+    uint32_t indexSize;             // numero di slot dell'indice, potenza di due
+    const uint32_t *successorStart; // id -> primo successore, wordCount + 1 elementi
+    const uint32_t *successors;     // id dei successori
+    const uint32_t *weights;        // peso di ciascun successore
+    const uint32_t *aliasThreshold; // tabella alias: la colonna si tiene sotto questa soglia
+    const uint32_t *aliasIndex;     // tabella alias: posizione alternativa nel blocco
+    const uint32_t *aliasCapacity;  // id -> capacità delle colonne del blocco, 0 se non estraibile
+    uint32_t firstWord;             // prima parola del testo analizzato, se nota
+    uint32_t lastWord;              // ultimo token del testo analizzato, se noto
+    Arena arena;                    // memoria degli array del modello
+    void *mapping;                  // file mappato da cui provengono gli array, se presente
+    size_t mappingSize;
+} GenerationModel;
+
+// raccoglie le coppie di parole prima di costruire il modello
+typedef struct ModelBuilder {
+    Arena arena;
+    StringPool words;
+    uint32_t *from;
+    uint32_t *to;
+    uint32_t *weight;
+    size_t count;
+    size_t capacity;
+} ModelBuilder;
+
+// inizializza un modello vuoto
+void init_generation_model(GenerationModel *model);
+
+// copia nel modello le parole di un insieme di stringhe e ne costruisce l'indice
+void set_model_words(GenerationModel *model, const StringPool *words);
+
+// precalcola le tabelle alias a partire da successori e pesi
+void build_alias_tables(GenerationModel *model);
+
+// inizializza il costruttore del modello
+void init_model_builder(ModelBuilder *builder);
+
+// aggiunge una coppia (parola, successiva) con il suo peso
+void model_builder_add(ModelBuilder *builder, const char *word, const char *next_word, uint32_t weight);
+
+// porta lo spazio delle coppie ad almeno capacity elementi
+void model_builder_reserve(ModelBuilder *builder, size_t capacity);
+
+// aggiunge una coppia di parole già internate in builder->words
+void model_builder_add_ids(ModelBuilder *builder, uint32_t from, uint32_t to, uint32_t weight);
+
+// costruisce il modello e libera il costruttore
+void finish_model_builder(ModelBuilder *builder, GenerationModel *model);
+
+// libera il costruttore senza costruire il modello
+void free_model_builder(ModelBuilder *builder);
+
+// restituisce l'id di una parola oppure NO_STRING se non è nel modello
+uint32_t find_model_word(const GenerationModel *model, const char *word);
+
+// restituisce la parola con un dato id
+static inline const char *model_word(const GenerationModel *model, uint32_t id) {
+    return model->wordData + model->wordOffsets[id];
+}
+
+// numero di successori di una parola
+static inline uint32_t model_successor_count(const GenerationModel *model, uint32_t id) {
+    return model->successorStart[id + 1] - model->successorStart[id];
+}
+
+// sceglie casualmente il successore di una parola; NO_STRING se non ne ha
+uint32_t sample_next_word(const GenerationModel *model, uint32_t word, Rng *rng);
+
+// sceglie una parola iniziale tra quelle che seguono una punteggiatura finale
+uint32_t select_initial_word(const GenerationModel *model, Rng *rng);
+
+// genera un testo di wordCount parole a partire da start; ritorna le parole scritte
+int generate_text(const GenerationModel *model, uint32_t start, int wordCount, Rng *rng, FILE *file);
+
+// libera la memoria del modello
+void free_generation_model(GenerationModel *model);
+
+#endif // GENERATION_MODEL_H
@@ -1,60 +1,85 @@
 #include "utilities.h"
 #include "text_analysis.h"
 #include "process_management.h"
+#include "shared_model.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <sys/wait.h>
 #include <string.h>
 
+/*
+ * legge la dimensione dei blocchi dello stage di input dalla variabile
+ * d'ambiente INPUT_CHUNK_SIZE, in byte
+ *
+ * ritorno
+ *   la dimensione richiesta, 0 per usare quella predefinita
+ */
+static size_t input_chunk_size(void) {
+    const char *value = getenv("INPUT_CHUNK_SIZE");
+    if (!value) {
+        return 0;
+    }
+    long long size = atoll(value);
+    if (size <= 0) {
+        fprintf(stderr, "Invalid INPUT_CHUNK_SIZE, using %d bytes\n", INPUT_CHUNK_SIZE);
+        return 0;
+    }
+    return (size_t)size;
+}
+
 int main(int argc, char *argv[]) {
     if ((argc != 4 && argc != 6) && (argc != 5)) {
         fprintf(stderr, "Usage: %s <mode> <input file> <output file> [<num words> <start word>]\n", argv[0]);
+        fprintf(stderr, "       %s analysis <input file> <output file> [<analyzers>]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
     const char *mode = argv[1];
-    const char *inputFilePath = "/Users/emanuelestorci/Documents/c/UniMultiC/input.txt";
-    const char *outputFilePath = "/Users/emanuelestorci/Documents/c/UniMultiC/output.txt";
+    const char *inputFilePath = argv[2];
+    const char *outputFilePath = argv[3];
     int num_words = (argc > 4) ? atoi(argv[4]) : 0;
     const char *start_word = (argc == 6) ? argv[5] : NULL;
 
+    StageOptions options = {inputFilePath, outputFilePath, input_chunk_size(), NULL, num_words, start_word};
+
     if (strcmp(mode, "analysis") == 0) {
-        int pipe1[2], pipe2[2];
-        if (pipe(pipe1) == -1 || pipe(pipe2) == -1) {
-            perror("Failed to create pipes");
+        // lettura, smistamento dei token, N contatori con una parte disgiunta della tabella, raccolta
+        int analyzers = (argc == 5) ? atoi(argv[4]) : 1;
+        if (analyzers <= 0) {
+            fprintf(stderr, "Invalid number of analyzers: %s\n", argv[4]);
             return EXIT_FAILURE;
         }
 
-        printf("pipe1: %d %d, pipe2: %d %d ", pipe1[0], pipe1[1], pipe2[0], pipe2[1]);
-
-        pid_t pidInput = create_input_process(inputFilePath, pipe1[1]);
-        close(pipe1[1]);
-
-        pid_t pidAnalysis = create_analysis_process(pipe1[0], pipe2[1]);
-        close(pipe1[0]);
-        close(pipe2[1]);
-
-        wait_for_processes(pidInput, pidAnalysis, -1);
+        PipelineStage stages[] = {
+            {"read", stage_read, 1, LINK_NONE, &options},
+            {"tokenize", stage_route, 1, LINK_PIPE, &options},
+            {"count", stage_count, (size_t)analyzers, LINK_RING, &options},
+            {"gather", stage_gather, 1, LINK_PIPE, &options},
+        };
+        return run_pipeline(stages, sizeof(stages) / sizeof(stages[0])) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
 
-        FILE *outputFile = fopen(outputFilePath, "w");
-        if (!outputFile) {
-            perror("Failed to open output file");
+    if (strcmp(mode, "generate") == 0 && argc >= 5) {
+        if (num_words <= 0) {
+            fprintf(stderr, "Invalid number of words to generate: %s\n", argv[4]);
             return EXIT_FAILURE;
         }
 
-        char buffer[1024];
-        ssize_t bytesRead;
-        while ((bytesRead = read(pipe2[0], buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[bytesRead] = '\0';
-            fputs(buffer, outputFile);
-        }
-
-        fclose(outputFile);
-        close(pipe2[0]);
+        // il modello passa dall'analisi al generatore in memoria condivisa
+        char modelName[SHARED_MODEL_NAME_SIZE];
+        shared_model_name(modelName, sizeof(modelName), getpid());
+        options.modelName = modelName;
 
-        return EXIT_SUCCESS;
+        PipelineStage stages[] = {
+            {"read", stage_read, 1, LINK_NONE, &options},
+            {"model", stage_build_model, 1, LINK_PIPE, &options},
+            {"generate", stage_generate, 1, LINK_AFTER, &options},
+        };
+        int success = run_pipeline(stages, sizeof(stages) / sizeof(stages[0]));
+        remove_shared_model(modelName);
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    fprintf(stderr, "Invalid mode: %s\n", mode);
+    return EXIT_FAILURE;
 }
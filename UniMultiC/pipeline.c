@@ -0,0 +1,463 @@
+/*
+ * runtime generico per pipeline di processi
+ * ogni stage viene dichiarato con il numero di processi e il tipo di collegamento
+ * con lo stage precedente; il runtime crea una pipe o una coda condivisa per
+ * ogni coppia di processi adiacenti, avvia i processi, ne sorveglia l'uscita
+ * (se uno fallisce gli altri vengono terminati) e misura la durata di ogni stage
+ */
+#define _GNU_SOURCE // fopencookie
+#include "pipeline.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// collegamento tra due processi, come lo crea il genitore
+typedef struct PipelineChannel {
+    int fds[2];
+    SharedRing *ring;
+} PipelineChannel;
+
+// processo avviato dal runtime
+typedef struct StageProcess {
+    pid_t pid;
+    size_t stage;
+    size_t index;
+    struct timespec start;
+    struct timespec end;
+    int done;
+} StageProcess;
+
+/*
+ * scrive tutti i byte su un descrittore; un errore termina il processo dello stage
+ */
+static void write_all(int fd, const void *data, size_t size) {
+    const char *bytes = data;
+    while (size > 0) {
+        ssize_t count = write(fd, bytes, size);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            perror("Failed to write pipeline channel");
+            exit(EXIT_FAILURE);
+        }
+        bytes += count;
+        size -= (size_t)count;
+    }
+}
+
+/*
+ * restituisce il buffer della pipe, allocandolo al primo uso
+ */
+static unsigned char *channel_buffer(StageChannel *channel) {
+    if (!channel->buffer) {
+        channel->buffer = malloc(CHANNEL_BUFFER_SIZE);
+        if (!channel->buffer) {
+            fprintf(stderr, "Memory allocation failed for channel buffer\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return channel->buffer;
+}
+
+/*
+ * legge fino a size byte dal collegamento, attendendo lo stage precedente
+ *
+ * parametri
+ *   channel: collegamento in ingresso
+ *   data: buffer di destinazione
+ *   size: byte richiesti
+ *
+ * ritorno
+ *   i byte letti; sono meno di size solo quando lo stage precedente ha finito
+ */
+size_t channel_read(StageChannel *channel, void *data, size_t size) {
+    if (channel->ring) {
+        return ring_read(&channel->consumer, data, size);
+    }
+
+    unsigned char *destination = data;
+    size_t done = 0;
+    while (done < size) {
+        if (channel->start == channel->end) {
+            // richieste grandi vanno direttamente nel buffer del chiamante
+            int direct = size - done >= CHANNEL_BUFFER_SIZE;
+            unsigned char *target = direct ? destination + done : channel_buffer(channel);
+            ssize_t bytesRead = read(channel->fd, target, direct ? size - done : CHANNEL_BUFFER_SIZE);
+            if (bytesRead < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytesRead < 0) {
+                perror("Failed to read pipeline channel");
+                exit(EXIT_FAILURE);
+            }
+            if (bytesRead == 0) {
+                break;
+            }
+            if (direct) {
+                done += (size_t)bytesRead;
+                continue;
+            }
+            channel->start = 0;
+            channel->end = (size_t)bytesRead;
+        }
+        size_t count = channel->end - channel->start;
+        if (count > size - done) {
+            count = size - done;
+        }
+        memcpy(destination + done, channel->buffer + channel->start, count);
+        channel->start += count;
+        done += count;
+    }
+    return done;
+}
+
+/*
+ * scrive size byte nel collegamento
+ * sulle pipe i byte vengono accumulati nel buffer e inviati a blocchi
+ *
+ * parametri
+ *   channel: collegamento in uscita
+ *   data: byte da scrivere
+ *   size: numero di byte
+ */
+void channel_write(StageChannel *channel, const void *data, size_t size) {
+    if (channel->ring) {
+        ring_write(&channel->producer, data, size);
+        return;
+    }
+    if (channel->end + size > CHANNEL_BUFFER_SIZE) {
+        channel_flush(channel);
+    }
+    if (size >= CHANNEL_BUFFER_SIZE) {
+        write_all(channel->fd, data, size);
+        return;
+    }
+    memcpy(channel_buffer(channel) + channel->end, data, size);
+    channel->end += size;
+}
+
+/*
+ * invia allo stage successivo i byte ancora nel buffer
+ */
+void channel_flush(StageChannel *channel) {
+    if (channel->ring) {
+        ring_flush(&channel->producer);
+    } else if (channel->end > 0) {
+        write_all(channel->fd, channel->buffer, channel->end);
+        channel->end = 0;
+    }
+}
+
+#ifdef __linux__
+static ssize_t channel_stream_write(void *cookie, const char *data, size_t size) {
+    channel_write(cookie, data, size);
+    return (ssize_t)size;
+}
+#else
+static int channel_stream_write(void *cookie, const char *data, int size) {
+    channel_write(cookie, data, (size_t)size);
+    return size;
+}
+#endif
+
+/*
+ * apre uno stream stdio che scrive nel collegamento
+ * permette di riusare le funzioni che stampano su FILE*, come print_word_table
+ *
+ * ritorno
+ *   lo stream, da chiudere con fclose prima della fine dello stage
+ */
+FILE *channel_open_stream(StageChannel *channel) {
+#ifdef __linux__
+    cookie_io_functions_t functions = {NULL, channel_stream_write, NULL, NULL};
+    FILE *stream = fopencookie(channel, "w", functions);
+#else
+    FILE *stream = funopen(channel, NULL, channel_stream_write, NULL, NULL);
+#endif
+    if (!stream) {
+        perror("Failed to open channel stream");
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(stream, NULL, _IOFBF, CHANNEL_BUFFER_SIZE);
+    return stream;
+}
+
+/*
+ * numero di processi di uno stage
+ */
+static size_t stage_parallelism(const PipelineStage *stage) {
+    return stage->parallelism > 0 ? stage->parallelism : 1;
+}
+
+/*
+ * durata in secondi tra due istanti
+ */
+static double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * chiude tutte le pipe di un gruppo tranne quelle indicate
+ */
+static void close_group_pipes(PipelineChannel **channels, const PipelineStage *stages, size_t first, size_t last,
+                              const int *keep, size_t keepCount) {
+    for (size_t s = first + 1; s < last; s++) {
+        if (!channels[s]) continue;
+        size_t count = stage_parallelism(&stages[s - 1]) * stage_parallelism(&stages[s]);
+        for (size_t c = 0; c < count; c++) {
+            for (int end = 0; end < 2; end++) {
+                int fd = channels[s][c].fds[end];
+                int kept = 0;
+                for (size_t k = 0; k < keepCount; k++) {
+                    kept |= keep[k] == fd;
+                }
+                if (fd >= 0 && !kept) {
+                    close(fd);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * corpo di un processo figlio: collega gli ingressi e le uscite, esegue lo stage
+ * e chiude le uscite, così lo stage successivo vede la fine dei dati
+ */
+static void run_stage_process(PipelineChannel **channels, const PipelineStage *stages, size_t first, size_t last,
+                              size_t s, size_t i) {
+    const PipelineStage *stage = &stages[s];
+    size_t parallelism = stage_parallelism(stage);
+    StageContext context = {i, parallelism, NULL, 0, NULL, 0, stage->arg};
+
+    if (channels[s]) {
+        context.inputCount = stage_parallelism(&stages[s - 1]);
+    }
+    if (s + 1 < last && channels[s + 1]) {
+        context.outputCount = stage_parallelism(&stages[s + 1]);
+    }
+    context.inputs = calloc(context.inputCount + 1, sizeof(StageChannel));
+    context.outputs = calloc(context.outputCount + 1, sizeof(StageChannel));
+    int *keep = malloc((context.inputCount + context.outputCount + 1) * sizeof(int));
+    if (!context.inputs || !context.outputs || !keep) {
+        fprintf(stderr, "Memory allocation failed for stage channels\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // l'ingresso k è il collegamento dal processo k dello stage precedente
+    size_t keepCount = 0;
+    for (size_t k = 0; k < context.inputCount; k++) {
+        PipelineChannel *channel = &channels[s][k * parallelism + i];
+        context.inputs[k].fd = channel->fds[0];
+        context.inputs[k].ring = channel->ring;
+        if (channel->ring) {
+            ring_consumer_init(&context.inputs[k].consumer, channel->ring);
+        } else {
+            keep[keepCount++] = channel->fds[0];
+        }
+    }
+    // l'uscita j è il collegamento verso il processo j dello stage successivo
+    for (size_t j = 0; j < context.outputCount; j++) {
+        PipelineChannel *channel = &channels[s + 1][i * context.outputCount + j];
+        context.outputs[j].fd = channel->fds[1];
+        context.outputs[j].ring = channel->ring;
+        if (channel->ring) {
+            ring_producer_init(&context.outputs[j].producer, channel->ring);
+        } else {
+            keep[keepCount++] = channel->fds[1];
+        }
+    }
+    close_group_pipes(channels, stages, first, last, keep, keepCount);
+
+    int status = stage->run(&context);
+
+    for (size_t j = 0; j < context.outputCount; j++) {
+        StageChannel *output = &context.outputs[j];
+        if (output->ring) {
+            ring_close(&output->producer);
+        } else {
+            channel_flush(output);
+            close(output->fd);
+        }
+    }
+    exit(status);
+}
+
+/*
+ * avvia un gruppo di stage collegati e attende che terminino
+ * se un processo fallisce, tutti gli altri processi del gruppo vengono terminati
+ *
+ * ritorno
+ *   1 se tutti i processi sono terminati con successo, 0 altrimenti
+ */
+static int run_stage_group(const PipelineStage *stages, size_t first, size_t last,
+                           struct timespec *stageStart, struct timespec *stageEnd) {
+    // crea i collegamenti: channels[s] unisce lo stage s - 1 allo stage s
+    PipelineChannel **channels = calloc(last + 1, sizeof(PipelineChannel *));
+    size_t processCount = 0;
+    if (!channels) {
+        fprintf(stderr, "Memory allocation failed for pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t s = first; s < last; s++) {
+        processCount += stage_parallelism(&stages[s]);
+        if (s == first || stages[s].input == LINK_NONE) continue;
+
+        size_t count = stage_parallelism(&stages[s - 1]) * stage_parallelism(&stages[s]);
+        channels[s] = malloc(count * sizeof(PipelineChannel));
+        if (!channels[s]) {
+            fprintf(stderr, "Memory allocation failed for pipeline\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t c = 0; c < count; c++) {
+            channels[s][c].fds[0] = channels[s][c].fds[1] = -1;
+            channels[s][c].ring = NULL;
+            if (stages[s].input == LINK_RING) {
+                channels[s][c].ring = ring_create(PIPELINE_RING_SIZE);
+            } else if (pipe(channels[s][c].fds) == -1) {
+                perror("Failed to create pipes");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    StageProcess *processes = calloc(processCount, sizeof(StageProcess));
+    if (!processes) {
+        fprintf(stderr, "Memory allocation failed for pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fflush(stdout); // i figli non devono ereditare output in sospeso
+    fflush(stderr);
+    size_t started = 0;
+    for (size_t s = first; s < last; s++) {
+        for (size_t i = 0; i < stage_parallelism(&stages[s]); i++) {
+            StageProcess *process = &processes[started];
+            process->stage = s;
+            process->index = i;
+            clock_gettime(CLOCK_MONOTONIC, &process->start);
+            process->pid = fork();
+            if (process->pid < 0) {
+                perror("fork fallita");
+                exit(EXIT_FAILURE);
+            } else if (process->pid == 0) {
+                run_stage_process(channels, stages, first, last, s, i);
+            }
+            started++;
+        }
+    }
+
+    // il genitore non usa i collegamenti: chiude le pipe e rilascia le code
+    close_group_pipes(channels, stages, first, last, NULL, 0);
+    for (size_t s = first + 1; s < last; s++) {
+        if (!channels[s]) continue;
+        size_t count = stage_parallelism(&stages[s - 1]) * stage_parallelism(&stages[s]);
+        for (size_t c = 0; c < count; c++) {
+            if (channels[s][c].ring) {
+                ring_destroy(channels[s][c].ring);
+            }
+        }
+        free(channels[s]);
+    }
+    free(channels);
+
+    // sorveglia i processi: il primo fallimento ferma l'intera pipeline
+    int success = 1;
+    size_t running = processCount;
+    while (running > 0) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        StageProcess *process = NULL;
+        for (size_t p = 0; p < processCount; p++) {
+            if (processes[p].pid == pid && !processes[p].done) {
+                process = &processes[p];
+            }
+        }
+        if (!process) continue;
+
+        clock_gettime(CLOCK_MONOTONIC, &process->end);
+        process->done = 1;
+        running--;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (success) {
+                fprintf(stderr, "Stage %s (process %zu) failed, stopping the pipeline\n",
+                        stages[process->stage].name, process->index);
+                for (size_t p = 0; p < processCount; p++) {
+                    if (!processes[p].done) {
+                        kill(processes[p].pid, SIGTERM);
+                    }
+                }
+            }
+            success = 0;
+        }
+    }
+
+    // la durata di uno stage va dal primo avvio all'ultima uscita dei suoi processi
+    for (size_t p = 0; p < processCount; p++) {
+        const StageProcess *process = &processes[p];
+        size_t s = process->stage;
+        if (process->index == 0) {
+            stageStart[s] = process->start;
+            stageEnd[s] = process->end;
+            continue;
+        }
+        if (elapsed_seconds(&process->start, &stageStart[s]) > 0) {
+            stageStart[s] = process->start;
+        }
+        if (elapsed_seconds(&stageEnd[s], &process->end) > 0) {
+            stageEnd[s] = process->end;
+        }
+    }
+    free(processes);
+    return success;
+}
+
+/*
+ * esegue una pipeline di stage
+ * gli stage collegati da pipe o code girano in parallelo; uno stage LINK_AFTER
+ * parte solo quando tutti i precedenti sono terminati con successo. Alla fine
+ * viene stampata la durata di ogni stage eseguito
+ *
+ * parametri
+ *   stages: stage nell'ordine in cui i dati li attraversano
+ *   stageCount: numero di stage
+ *
+ * ritorno
+ *   1 se tutti i processi sono terminati con successo, 0 altrimenti
+ */
+int run_pipeline(const PipelineStage *stages, size_t stageCount) {
+    struct timespec *stageStart = calloc(stageCount + 1, sizeof(struct timespec));
+    struct timespec *stageEnd = calloc(stageCount + 1, sizeof(struct timespec));
+    if (!stageStart || !stageEnd) {
+        fprintf(stderr, "Memory allocation failed for pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int success = 1;
+    size_t executed = 0;
+    while (success && executed < stageCount) {
+        size_t last = executed + 1;
+        while (last < stageCount && stages[last].input != LINK_AFTER) {
+            last++;
+        }
+        success = run_stage_group(stages, executed, last, stageStart, stageEnd);
+        executed = last;
+    }
+
+    for (size_t s = 0; s < executed; s++) {
+        size_t parallelism = stage_parallelism(&stages[s]);
+        printf("Stage %s: %zu process%s, %.3f s\n", stages[s].name, parallelism, parallelism == 1 ? "" : "es",
+               elapsed_seconds(&stageStart[s], &stageEnd[s]));
+    }
+    free(stageStart);
+    free(stageEnd);
+    return success;
+}
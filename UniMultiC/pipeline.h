@@ -0,0 +1,69 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include "ring.h"
+
+#define PIPELINE_RING_SIZE (4 * 1024 * 1024)   // coda condivisa di ogni collegamento LINK_RING
+#define CHANNEL_BUFFER_SIZE (256 * 1024)       // buffer dei collegamenti su pipe
+
+// come uno stage riceve i dati dallo stage precedente
+typedef enum PipelineLink {
+    LINK_NONE,      // nessun ingresso: primo stage della pipeline
+    LINK_PIPE,      // una pipe per ogni coppia di processi
+    LINK_RING,      // una coda condivisa senza lock per ogni coppia di processi
+    LINK_AFTER      // nessun dato: lo stage parte quando i precedenti sono terminati con successo
+} PipelineLink;
+
+// estremità di un collegamento vista da un processo
+typedef struct StageChannel {
+    int fd;                     // pipe, -1 se il collegamento è una coda condivisa
+    SharedRing *ring;
+    RingProducer producer;
+    RingConsumer consumer;
+    unsigned char *buffer;      // buffer della pipe, allocato al primo uso
+    size_t start;
+    size_t end;
+} StageChannel;
+
+// tutto ciò che un processo di uno stage vede della pipeline
+typedef struct StageContext {
+    size_t index;               // istanza dello stage, da 0 a parallelism - 1
+    size_t parallelism;
+    StageChannel *inputs;       // uno per ogni processo dello stage precedente
+    size_t inputCount;
+    StageChannel *outputs;      // uno per ogni processo dello stage successivo
+    size_t outputCount;
+    void *arg;
+} StageContext;
+
+// corpo di uno stage; ritorna il codice di uscita del processo
+typedef int (*StageFunction)(StageContext *context);
+
+// dichiarazione di uno stage
+typedef struct PipelineStage {
+    const char *name;
+    StageFunction run;
+    size_t parallelism;         // numero di processi dello stage
+    PipelineLink input;         // collegamento con lo stage precedente
+    void *arg;
+} PipelineStage;
+
+// esegue la pipeline e ne sorveglia i processi; ritorna 1 se tutti sono terminati con successo
+int run_pipeline(const PipelineStage *stages, size_t stageCount);
+
+// legge fino a size byte; ritorna meno di size solo a fine dati
+size_t channel_read(StageChannel *channel, void *data, size_t size);
+
+// scrive size byte nel collegamento
+void channel_write(StageChannel *channel, const void *data, size_t size);
+
+// rende visibili allo stage successivo i byte scritti
+void channel_flush(StageChannel *channel);
+
+// apre uno stream stdio in scrittura sul collegamento
+FILE *channel_open_stream(StageChannel *channel);
+
+#endif // PIPELINE_H
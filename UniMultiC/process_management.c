@@ -1,111 +1,501 @@
+#define _GNU_SOURCE // splice(2), F_SETPIPE_SZ
+/*
+ * stage delle pipeline di UniMultiC
+ * ogni funzione stage_* è il corpo di un processo avviato da run_pipeline:
+ * legge dagli ingressi del proprio contesto e scrive nelle uscite, senza sapere
+ * se il collegamento è una pipe o una coda condivisa
+ */
 #include "process_management.h"
 #include "utilities.h"
 #include "text_analysis.h"
+#include "binary_model.h"
+#include "shared_model.h"
+#include "rng.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
-#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 
-pid_t create_input_process(const char *inputFilePath, int output_fd) {
-    pid_t pid = fork();
-    if (pid == 0) {
-        dup2(output_fd, STDOUT_FILENO);
-        close(output_fd);
+#define DRAIN_CHUNK_SIZE (1024 * 1024) // byte spostati per ogni chiamata durante lo svuotamento
 
-        execlp("cat", "cat", inputFilePath, NULL);
-        perror("Failed to execute input process");
+/*
+ * sposta il file nella pipe con splice(2): i dati passano dalla cache del file
+ * alla pipe senza essere copiati nello spazio utente
+ *
+ * ritorno
+ *   i byte spostati, -1 se splice non è disponibile per questo file
+ */
+static long long splice_input(int input_fd, int output_fd, size_t chunkSize, long *chunks) {
+#ifdef __linux__
+    long long total = 0;
+    for (;;) {
+        ssize_t moved = splice(input_fd, NULL, output_fd, NULL, chunkSize, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved > 0) {
+            total += moved;
+            (*chunks)++;
+            continue;
+        }
+        if (moved == 0) {
+            return total;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (total == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            return -1; // nessun dato spostato: si può ancora leggere a blocchi
+        }
+        perror("Failed to splice input file");
         exit(EXIT_FAILURE);
     }
-    close(output_fd);
-    return pid;
+#else
+    (void)input_fd;
+    (void)output_fd;
+    (void)chunkSize;
+    (void)chunks;
+    return -1;
+#endif
 }
 
-pid_t create_analysis_process(int input_fd, int output_fd) {
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("fork fallita");
+/*
+ * copia il file nel collegamento a blocchi letti in un buffer allineato alla pagina
+ *
+ * ritorno
+ *   i byte copiati
+ */
+static long long read_input(int input_fd, StageChannel *output, size_t chunkSize, long *chunks) {
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, (size_t)sysconf(_SC_PAGESIZE), chunkSize) != 0) {
+        fprintf(stderr, "Memory allocation failed for input buffer\n");
         exit(EXIT_FAILURE);
-    } else if (pid == 0) {
-        printf("processo figlio creato %d \n",getpid());
-        printf("prima input fd %d, output %d",input_fd,output_fd);
-
-        //dup2(input_fd, STDIN_FILENO);
-        if (dup2(input_fd,STDIN_FILENO) < 0) {
-            perror("dup input fallita");
-            fprintf(stderr,"dup in fallita");
-            exit(EXIT_FAILURE);
+    }
+
+    long long total = 0;
+    for (;;) {
+        ssize_t bytesRead = read(input_fd, buffer, chunkSize);
+        if (bytesRead == 0) {
+            break;
         }
-        //dup2(output_fd, STDOUT_FILENO);
-        if (dup2(output_fd,STDOUT_FILENO) < 0) {
-            perror("dup output fallita");
-            fprintf(stderr,"dup out fallita");
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Failed to read input file");
             exit(EXIT_FAILURE);
         }
+        channel_write(output, buffer, (size_t)bytesRead);
+        channel_flush(output);
+        total += bytesRead;
+        (*chunks)++;
+    }
+    free(buffer);
+    return total;
+}
 
-        printf("dopo dup2");
-        close(input_fd);
-        close(output_fd);
+/*
+ * stage di input: scrive il file nel collegamento verso lo stage successivo
+ * su una pipe usa splice quando il sistema lo permette, altrimenti letture a
+ * blocchi di chunkSize byte; alla fine stampa byte, blocchi e velocità
+ *
+ * ritorno
+ *   EXIT_SUCCESS se il file è stato letto per intero
+ */
+int stage_read(StageContext *context) {
+    const StageOptions *options = context->arg;
+    if (context->outputCount != 1) {
+        fprintf(stderr, "The read stage needs exactly one consumer\n");
+        return EXIT_FAILURE;
+    }
+    StageChannel *output = &context->outputs[0];
 
-        WordTable table;
-        printf("prima di init word");
-        init_word_table(&table, 1000);
-        printf("dopo di init word");
+    int input_fd = open(options->inputFilePath, O_RDONLY);
+    if (input_fd < 0) {
+        perror("Failed to open input file");
+        return EXIT_FAILURE;
+    }
+    size_t chunkSize = options->chunkSize > 0 ? options->chunkSize : INPUT_CHUNK_SIZE;
+#ifdef __linux__
+    if (output->fd >= 0) {
+        fcntl(output->fd, F_SETPIPE_SZ, (int)chunkSize); // buffer della pipe grande quanto un blocco, se permesso
+    }
+    posix_fadvise(input_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
-        FILE *inputStream = fdopen(STDIN_FILENO, "r");
-        if (!inputStream) {
-            perror("errore nell aprire input stream");
-            exit(EXIT_FAILURE);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long chunks = 0;
+    const char *method = "splice";
+    long long total = output->fd >= 0 ? splice_input(input_fd, output->fd, chunkSize, &chunks) : -1;
+    if (total < 0) {
+        method = "read";
+        total = read_input(input_fd, output, chunkSize, &chunks);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    close(input_fd);
+
+    double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Input stage: %lld bytes in %ld chunks (%s), %.3f s, %.1f MiB/s\n", total, chunks, method,
+           seconds, seconds > 0 ? (double)total / (1024.0 * 1024.0) / seconds : 0.0);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * passa al tokenizzatore tutto il testo in arrivo dagli ingressi, nell'ordine
+ */
+static void scan_inputs(StageContext *context, TextScanner *scanner) {
+    char *buffer = malloc(INPUT_CHUNK_SIZE);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for input buffer\n");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < context->inputCount; i++) {
+        size_t bytesRead;
+        do {
+            bytesRead = channel_read(&context->inputs[i], buffer, INPUT_CHUNK_SIZE);
+            scan_text(scanner, buffer, bytesRead);
+        } while (bytesRead == INPUT_CHUNK_SIZE);
+    }
+    finish_text_scanner(scanner);
+    free(buffer);
+}
+
+// stato dello stage di smistamento: il vocabolario visto finora e le uscite
+typedef struct ShardRouter {
+    const WordTable *table;     // usato per gli hash delle parole
+    StageContext *context;
+} ShardRouter;
+
+/*
+ * accoda un token al messaggio, preceduto dalla sua lunghezza
+ * i token sono lunghi al massimo 255 byte, quindi la lunghezza occupa un byte
+ */
+static size_t put_token(unsigned char *message, const char *token) {
+    size_t length = strlen(token);
+    message[0] = (unsigned char)length;
+    memcpy(message + 1, token, length);
+    return length + 1;
+}
+
+/*
+ * inoltra una coppia allo shard che possiede la parola corrente
+ */
+static void route_pair(void *arg, uint32_t word, uint32_t next) {
+    ShardRouter *router = arg;
+    const StringPool *words = &router->table->words;
+    unsigned char message[2 * 256];
+    size_t size = put_token(message, pool_string(words, word));
+    size += put_token(message + size, pool_string(words, next));
+    StageContext *context = router->context;
+    channel_write(&context->outputs[words->hashes[word] % context->outputCount], message, size);
+}
+
+/*
+ * stage di smistamento: divide il testo in token e invia ogni coppia allo
+ * shard scelto dall'hash della parola corrente, compresa la coppia che collega
+ * l'ultimo token alla prima parola
+ *
+ * ritorno
+ *   EXIT_SUCCESS al termine del testo
+ */
+int stage_route(StageContext *context) {
+    if (context->outputCount == 0) {
+        fprintf(stderr, "The route stage needs at least one consumer\n");
+        return EXIT_FAILURE;
+    }
+
+    WordTable table;
+    init_word_table(&table, HASH_SIZE);
+    ShardRouter router = {&table, context};
+
+    TextScanner scanner;
+    init_text_scanner(&scanner, &table);
+    scanner.emitPair = route_pair;
+    scanner.emitContext = &router;
+    scan_inputs(context, &scanner);
+
+    // collega l'ultima parola con la prima parola trovata
+    if (scanner.firstWord && scanner.lastWord != NO_STRING) {
+        route_pair(&router, scanner.lastWord, word_table_intern(&table, scanner.firstWord));
+    }
+
+    free(scanner.firstWord);
+    free_word_table(&table);
+    return EXIT_SUCCESS;
+}
+
+/*
+ * legge un token preceduto dalla sua lunghezza
+ *
+ * ritorno
+ *   1 se il token è stato letto, 0 a fine dati
+ */
+static int read_token(StageChannel *channel, char *token) {
+    unsigned char length;
+    if (channel_read(channel, &length, 1) == 0) {
+        return 0;
+    }
+    if (channel_read(channel, token, length) != length) {
+        fprintf(stderr, "Truncated shard stream\n");
+        exit(EXIT_FAILURE);
+    }
+    token[length] = '\0';
+    return 1;
+}
+
+/*
+ * stage di conteggio: somma le coppie ricevute e scrive la sua parte del csv
+ * ogni istanza possiede le parole correnti con un certo hash, quindi le righe
+ * delle diverse istanze sono disgiunte e basta concatenarle
+ *
+ * ritorno
+ *   EXIT_SUCCESS se il csv è stato scritto
+ */
+int stage_count(StageContext *context) {
+    if (context->outputCount != 1) {
+        fprintf(stderr, "The count stage needs exactly one consumer\n");
+        return EXIT_FAILURE;
+    }
+
+    WordTable table;
+    init_word_table(&table, HASH_SIZE);
+    char word[256];
+    char next[256];
+    for (size_t i = 0; i < context->inputCount; i++) {
+        while (read_token(&context->inputs[i], word)) {
+            if (!read_token(&context->inputs[i], next)) {
+                fprintf(stderr, "Truncated shard stream\n");
+                return EXIT_FAILURE;
+            }
+            add_word(&table, word, next);
         }
+    }
+
+    FILE *outputStream = channel_open_stream(&context->outputs[0]);
+    int failed = print_word_table(&table, outputStream, NULL) != 0;
+    if (fclose(outputStream) != 0) {
+        failed = 1;
+    }
+    free_word_table(&table);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-        char *firstWord = NULL;
-        char *lastWord = NULL;
-        analyze_text(inputStream, &table, &firstWord, &lastWord);
-        fclose(inputStream);
+/*
+ * stage di raccolta: concatena nel file di output quanto arriva dagli ingressi,
+ * nell'ordine delle istanze dello stage precedente
+ * le pipe vengono svuotate con drain_pipe_to_file, le code condivise a blocchi
+ *
+ * ritorno
+ *   EXIT_SUCCESS se il file è stato scritto per intero
+ */
+int stage_gather(StageContext *context) {
+    const StageOptions *options = context->arg;
+    int outputFd = open(options->outputFilePath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outputFd < 0) {
+        perror("Failed to open output file");
+        return EXIT_FAILURE;
+    }
 
-        FILE *outputStream = fdopen(STDOUT_FILENO, "w");
-        if (!outputStream) {
-            perror("errore nell aprire output stream");
+    char *buffer = NULL;
+    for (size_t i = 0; i < context->inputCount; i++) {
+        StageChannel *input = &context->inputs[i];
+        if (input->fd >= 0) {
+            if (drain_pipe_to_file(input->fd, outputFd) < 0) {
+                perror("Failed to write output file");
+                return EXIT_FAILURE;
+            }
+            continue;
+        }
+
+        if (!buffer && !(buffer = malloc(DRAIN_CHUNK_SIZE))) {
+            fprintf(stderr, "Memory allocation failed for output buffer\n");
             exit(EXIT_FAILURE);
         }
-        print_word_table(&table, outputStream, firstWord);
-        fflush(outputStream);
-        fclose(outputStream);
+        size_t bytesRead;
+        do {
+            bytesRead = channel_read(input, buffer, DRAIN_CHUNK_SIZE);
+            if (bytesRead > 0 && write(outputFd, buffer, bytesRead) != (ssize_t)bytesRead) {
+                perror("Failed to write output file");
+                return EXIT_FAILURE;
+            }
+        } while (bytesRead == DRAIN_CHUNK_SIZE);
+    }
+    free(buffer);
 
-        free_word_table(&table);
-        free(firstWord);
-        free(lastWord);
+    if (close(outputFd) != 0) {
+        perror("Failed to write output file");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+/*
+ * stage di costruzione del modello: analizza il testo e pubblica il modello
+ * nel segmento di memoria condivisa, senza passare dal csv
+ *
+ * ritorno
+ *   EXIT_SUCCESS se il modello è stato pubblicato
+ */
+int stage_build_model(StageContext *context) {
+    const StageOptions *options = context->arg;
 
-        exit(EXIT_SUCCESS);
+    WordTable table;
+    init_word_table(&table, HASH_SIZE);
+    TextScanner scanner;
+    init_text_scanner(&scanner, &table);
+    scan_inputs(context, &scanner);
+
+    char *lastWord = NULL;
+    if (scanner.lastWord != NO_STRING) {
+        lastWord = strdup(pool_string(&table.words, scanner.lastWord));
     }
-    close(input_fd);
-    close(output_fd);
-    return pid;
+    // collega l'ultima parola con la prima parola trovata
+    if (scanner.firstWord && lastWord) {
+        add_word(&table, lastWord, scanner.firstWord);
+    }
+
+    GenerationModel model;
+    build_model_from_tables(&table, 1, scanner.firstWord, lastWord, &model);
+    free_word_table(&table);
+    free(scanner.firstWord);
+    free(lastWord);
+
+    int published = publish_shared_model(options->modelName, &model);
+    free_generation_model(&model);
+    return published ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-pid_t create_generate_process(const char *csvFilePath, const char *outputFilePath, int num_words, const char *start_word) {
-    pid_t pid = fork();
-    if (pid == 0) {
-        char num_words_str[10];
-        sprintf(num_words_str, "%d", num_words);
+/*
+ * corpo del processo generatore: collega il modello condiviso e scrive il testo
+ *
+ * ritorno
+ *   EXIT_SUCCESS se il testo è stato generato, EXIT_FAILURE altrimenti
+ */
+static int run_generator(const char *modelName, const char *outputFilePath, int num_words, const char *start_word) {
+    GenerationModel model;
+    if (!attach_shared_model(modelName, &model)) {
+        return EXIT_FAILURE;
+    }
+
+    Rng rng;
+    rng_seed(&rng, rng_default_seed());
 
-        if (start_word) {
-            execlp("./generate_text", "./generate_text", csvFilePath, outputFilePath, num_words_str, start_word, NULL);
-        } else {
-            execlp("./generate_text", "./generate_text", csvFilePath, outputFilePath, num_words_str, NULL);
+    uint32_t startWord;
+    if (start_word) {
+        char *lowerStart = to_lowercase(start_word);
+        startWord = find_model_word(&model, lowerStart);
+        if (startWord == NO_STRING || model_successor_count(&model, startWord) == 0) {
+            fprintf(stderr, "La parola inserita non è presenta nel testo: %s\n", lowerStart);
+            free(lowerStart);
+            free_generation_model(&model);
+            return EXIT_FAILURE;
         }
+        free(lowerStart);
+    } else {
+        startWord = select_initial_word(&model, &rng);
+        if (startWord == NO_STRING) {
+            fprintf(stderr, "Failed to select initial word\n");
+            free_generation_model(&model);
+            return EXIT_FAILURE;
+        }
+    }
 
-        perror("Failed to execute generate process");
-        exit(EXIT_FAILURE);
+    FILE *outputFile = fopen(outputFilePath, "w");
+    if (!outputFile) {
+        perror("Failed to open output file");
+        free_generation_model(&model);
+        return EXIT_FAILURE;
+    }
+    if (generate_text(&model, startWord, num_words, &rng, outputFile) < num_words) {
+        fprintf(stderr, "Generated word is NULL.\n");
+    }
+    // fclose scrive la parte del testo rimasta nel buffer: un errore qui è un testo incompleto
+    int failed = fclose(outputFile) != 0;
+    if (failed) {
+        perror("Failed to write output file");
     }
-    return pid;
+    free_generation_model(&model);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
 
-void wait_for_processes(pid_t inputPid, pid_t analysisPid, pid_t generatePid) {
-    int status;
-    waitpid(inputPid, &status, 0);
-    waitpid(analysisPid, &status, 0);
-    if (generatePid != -1) {
-        waitpid(generatePid, &status, 0);
+/*
+ * stage di generazione: collega il modello condiviso e scrive il testo
+ */
+int stage_generate(StageContext *context) {
+    const StageOptions *options = context->arg;
+    return run_generator(options->modelName, options->outputFilePath, options->numWords, options->startWord);
+}
+
+/*
+ * copia tutto il contenuto di una pipe in un file fino alla chiusura della pipe
+ * va chiamata prima di attendere i processi che scrivono nella pipe: se il
+ * lettore aspettasse la loro terminazione, un output più grande del buffer del
+ * kernel li bloccherebbe in scrittura per sempre. Su Linux i dati passano dalla
+ * pipe al file con splice, senza copie nello spazio utente; altrove, o se il
+ * file non supporta splice, si usano letture e scritture a blocchi grandi
+ *
+ * parametri
+ *   input_fd: estremità di lettura della pipe
+ *   output_fd: file di destinazione
+ *
+ * ritorno
+ *   il numero di byte copiati, -1 in caso di errore
+ */
+long long drain_pipe_to_file(int input_fd, int output_fd) {
+    long long total = 0;
+
+#ifdef __linux__
+    for (;;) {
+        ssize_t moved = splice(input_fd, NULL, output_fd, NULL, DRAIN_CHUNK_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved > 0) {
+            total += moved;
+            continue;
+        }
+        if (moved == 0) {
+            return total;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno != EINVAL && errno != ENOSYS) {
+            return -1;
+        }
+        break; // splice non supportato per questo file: si passa alla copia a blocchi
+    }
+#endif
+
+    char *buffer = malloc(DRAIN_CHUNK_SIZE);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for pipe buffer\n");
+        exit(EXIT_FAILURE);
     }
+    for (;;) {
+        ssize_t bytesRead = read(input_fd, buffer, DRAIN_CHUNK_SIZE);
+        if (bytesRead == 0) {
+            break;
+        }
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            total = -1;
+            break;
+        }
+        for (ssize_t written = 0; written < bytesRead;) {
+            ssize_t count = write(output_fd, buffer + written, (size_t)(bytesRead - written));
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count < 0) {
+                free(buffer);
+                return -1;
+            }
+            written += count;
+        }
+        total += bytesRead;
+    }
+    free(buffer);
+    return total;
 }
+
@@ -2,19 +2,41 @@
 #define PROCESS_MANAGEMENT_H
 
 #include <unistd.h>
+#include "pipeline.h"
 #include "text_analysis.h"
 #include "text_generation.h"
 
-// crea un processo di input che legge un file
-pid_t create_input_process(const char *inputFilePath, int output_fd);
+#define INPUT_CHUNK_SIZE (1024 * 1024) // blocco predefinito dello stage di input
 
-// crea un processo di analisi del testo
-pid_t create_analysis_process(int input_fd, int output_fd);
+// parametri condivisi dagli stage di una pipeline, passati come arg
+typedef struct StageOptions {
+    const char *inputFilePath;
+    const char *outputFilePath;
+    size_t chunkSize;           // blocco dello stage di input, 0 per INPUT_CHUNK_SIZE
+    const char *modelName;      // segmento condiviso del modello
+    int numWords;
+    const char *startWord;      // NULL per sceglierla a caso
+} StageOptions;
 
-// crea un processo generatore di testo
-pid_t create_generate_process(const char *csvFilePath, const char *outputFilePath, int num_words, const char *start_word);
+// legge il file di input e lo scrive nel collegamento a blocchi di chunkSize byte
+int stage_read(StageContext *context);
 
-// attende la terminazione dei processi
-void wait_for_processes(pid_t inputPid, pid_t analysisPid, pid_t generatePid);
+// divide il testo in token e smista le coppie tra le istanze successive secondo l'hash della parola
+int stage_route(StageContext *context);
+
+// conta le coppie ricevute e scrive la propria parte del csv
+int stage_count(StageContext *context);
+
+// concatena nel file di output quanto arriva dagli stage precedenti
+int stage_gather(StageContext *context);
+
+// analizza il testo e pubblica il modello in memoria condivisa
+int stage_build_model(StageContext *context);
+
+// genera il testo dal modello in memoria condivisa
+int stage_generate(StageContext *context);
+
+// copia il contenuto di una pipe in un file fino alla sua chiusura; ritorna i byte copiati o -1
+long long drain_pipe_to_file(int input_fd, int output_fd);
 
 #endif // PROCESS_MANAGEMENT_H
@@ -0,0 +1,282 @@
+/*
+ * coda circolare senza lock per il trasporto dei token tra processi
+ * la coda vive in una mappatura condivisa creata prima di fork; produttore e
+ * consumatore si scambiano solo le due posizioni, aggiornate a blocchi di
+ * RING_BATCH byte. Le chiamate di sistema servono solo quando la coda è piena
+ * o vuota: il lato che deve aspettare dorme su un futex, l'altro lo sveglia
+ * solo se ha segnalato di essere in attesa
+ */
+#include "ring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#define RING_BATCH (64 * 1024) // byte scritti o letti prima di aggiornare la posizione condivisa
+
+#ifdef __linux__
+/*
+ * dorme finché il segnale vale ancora expected
+ * il futex non è privato perché la memoria è condivisa tra processi
+ */
+static void ring_sleep(_Atomic uint32_t *signal, uint32_t expected) {
+    syscall(SYS_futex, (uint32_t *)signal, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+/*
+ * cambia il segnale e sveglia l'eventuale processo in attesa
+ */
+static void ring_wake(_Atomic uint32_t *signal) {
+    atomic_fetch_add(signal, 1);
+    syscall(SYS_futex, (uint32_t *)signal, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+#else
+// senza futex l'attesa diventa un breve sonno seguito da un nuovo controllo
+static void ring_sleep(_Atomic uint32_t *signal, uint32_t expected) {
+    if (atomic_load(signal) == expected) {
+        usleep(50);
+    }
+}
+
+static void ring_wake(_Atomic uint32_t *signal) {
+    atomic_fetch_add(signal, 1);
+}
+#endif
+
+/*
+ * crea una coda condivisa
+ * la capacità viene arrotondata a una potenza di due, così la posizione nel
+ * buffer si ottiene con una maschera
+ *
+ * parametri
+ *   capacity: byte minimi della coda
+ *
+ * ritorno
+ *   la coda, in una mappatura anonima condivisa con i processi figli
+ */
+SharedRing *ring_create(size_t capacity) {
+    size_t size = 2 * RING_BATCH;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    SharedRing *ring = mmap(NULL, sizeof(SharedRing) + size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        perror("Failed to map shared ring");
+        exit(EXIT_FAILURE);
+    }
+    // la mappatura anonima parte azzerata: posizioni, segnali e flag sono già a zero
+    ring->capacity = size;
+    return ring;
+}
+
+/*
+ * libera la memoria della coda
+ */
+void ring_destroy(SharedRing *ring) {
+    munmap(ring, sizeof(SharedRing) + ring->capacity);
+}
+
+/*
+ * inizializza il lato produttore
+ */
+void ring_producer_init(RingProducer *producer, SharedRing *ring) {
+    producer->ring = ring;
+    producer->position = atomic_load(&ring->writePosition);
+    producer->published = producer->position;
+    producer->limit = atomic_load(&ring->readPosition) + ring->capacity;
+}
+
+/*
+ * rende visibili i byte scritti e sveglia il consumatore se sta aspettando
+ */
+static void publish(RingProducer *producer) {
+    SharedRing *ring = producer->ring;
+    atomic_store(&ring->writePosition, producer->position);
+    producer->published = producer->position;
+    if (atomic_load(&ring->consumerWaiting)) {
+        ring_wake(&ring->dataSignal);
+    }
+}
+
+/*
+ * attende che il consumatore liberi almeno un byte
+ * prima di dormire pubblica quanto scritto, altrimenti il consumatore potrebbe
+ * aspettare proprio quei byte
+ */
+static void wait_for_space(RingProducer *producer) {
+    SharedRing *ring = producer->ring;
+    for (;;) {
+        producer->limit = atomic_load_explicit(&ring->readPosition, memory_order_acquire) + ring->capacity;
+        if (producer->position < producer->limit) {
+            return;
+        }
+        if (producer->position != producer->published) {
+            publish(producer);
+        }
+
+        uint32_t signal = atomic_load(&ring->spaceSignal);
+        atomic_store(&ring->producerWaiting, 1);
+        if (producer->position < atomic_load(&ring->readPosition) + ring->capacity) {
+            atomic_store(&ring->producerWaiting, 0);
+            continue;
+        }
+        ring_sleep(&ring->spaceSignal, signal);
+        atomic_store(&ring->producerWaiting, 0);
+    }
+}
+
+/*
+ * copia size byte nella coda, attendendo quando è piena
+ *
+ * parametri
+ *   producer: lato produttore
+ *   data: byte da scrivere
+ *   size: numero di byte
+ */
+void ring_write(RingProducer *producer, const void *data, size_t size) {
+    SharedRing *ring = producer->ring;
+    const unsigned char *source = data;
+    uint64_t mask = ring->capacity - 1;
+
+    while (size > 0) {
+        if (producer->position == producer->limit) {
+            wait_for_space(producer);
+        }
+        size_t count = (size_t)(producer->limit - producer->position);
+        if (count > size) {
+            count = size;
+        }
+        size_t offset = (size_t)(producer->position & mask);
+        size_t first = count < ring->capacity - offset ? count : (size_t)(ring->capacity - offset);
+        memcpy(ring->data + offset, source, first);
+        memcpy(ring->data, source + first, count - first);
+
+        producer->position += count;
+        source += count;
+        size -= count;
+        if (producer->position - producer->published >= RING_BATCH) {
+            publish(producer);
+        }
+    }
+}
+
+/*
+ * rende visibili al consumatore tutti i byte scritti finora
+ */
+void ring_flush(RingProducer *producer) {
+    if (producer->position != producer->published) {
+        publish(producer);
+    }
+}
+
+/*
+ * pubblica gli ultimi byte e segnala che non ne arriveranno altri
+ */
+void ring_close(RingProducer *producer) {
+    SharedRing *ring = producer->ring;
+    atomic_store(&ring->writePosition, producer->position);
+    producer->published = producer->position;
+    atomic_store(&ring->closed, 1);
+    ring_wake(&ring->dataSignal);
+}
+
+/*
+ * inizializza il lato consumatore
+ */
+void ring_consumer_init(RingConsumer *consumer, SharedRing *ring) {
+    consumer->ring = ring;
+    consumer->position = atomic_load(&ring->readPosition);
+    consumer->released = consumer->position;
+    consumer->available = atomic_load(&ring->writePosition);
+}
+
+/*
+ * libera i byte letti e sveglia il produttore se sta aspettando
+ */
+static void release(RingConsumer *consumer) {
+    SharedRing *ring = consumer->ring;
+    atomic_store(&ring->readPosition, consumer->position);
+    consumer->released = consumer->position;
+    if (atomic_load(&ring->producerWaiting)) {
+        ring_wake(&ring->spaceSignal);
+    }
+}
+
+/*
+ * attende nuovi byte dal produttore
+ *
+ * ritorno
+ *   1 se ci sono byte da leggere, 0 se la coda è chiusa e vuota
+ */
+static int wait_for_data(RingConsumer *consumer) {
+    SharedRing *ring = consumer->ring;
+    for (;;) {
+        consumer->available = atomic_load_explicit(&ring->writePosition, memory_order_acquire);
+        if (consumer->available > consumer->position) {
+            return 1;
+        }
+        if (consumer->position != consumer->released) {
+            release(consumer);
+        }
+        if (atomic_load(&ring->closed)) {
+            // writePosition è definitiva prima che closed diventi 1
+            consumer->available = atomic_load(&ring->writePosition);
+            return consumer->available > consumer->position;
+        }
+
+        uint32_t signal = atomic_load(&ring->dataSignal);
+        atomic_store(&ring->consumerWaiting, 1);
+        if (atomic_load(&ring->writePosition) > consumer->position || atomic_load(&ring->closed)) {
+            atomic_store(&ring->consumerWaiting, 0);
+            continue;
+        }
+        ring_sleep(&ring->dataSignal, signal);
+        atomic_store(&ring->consumerWaiting, 0);
+    }
+}
+
+/*
+ * legge fino a size byte dalla coda, attendendo quando è vuota
+ *
+ * parametri
+ *   consumer: lato consumatore
+ *   data: buffer di destinazione
+ *   size: byte richiesti
+ *
+ * ritorno
+ *   i byte letti; sono meno di size solo se il produttore ha chiuso la coda
+ */
+size_t ring_read(RingConsumer *consumer, void *data, size_t size) {
+    SharedRing *ring = consumer->ring;
+    unsigned char *destination = data;
+    uint64_t mask = ring->capacity - 1;
+    size_t done = 0;
+
+    while (done < size) {
+        if (consumer->position == consumer->available && !wait_for_data(consumer)) {
+            break;
+        }
+        size_t count = (size_t)(consumer->available - consumer->position);
+        if (count > size - done) {
+            count = size - done;
+        }
+        size_t offset = (size_t)(consumer->position & mask);
+        size_t first = count < ring->capacity - offset ? count : (size_t)(ring->capacity - offset);
+        memcpy(destination + done, ring->data + offset, first);
+        memcpy(destination + done + first, ring->data, count - first);
+
+        consumer->position += count;
+        done += count;
+        if (consumer->position - consumer->released >= RING_BATCH) {
+            release(consumer);
+        }
+    }
+    return done;
+}
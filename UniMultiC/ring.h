@@ -0,0 +1,65 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_CACHE_LINE 64
+
+// coda circolare in memoria condivisa con un solo produttore e un solo consumatore
+// le posizioni crescono senza mai tornare indietro; il byte i si trova in data[i & (capacity - 1)]
+// ogni lato aggiorna solo la propria posizione, quindi non servono lock
+typedef struct SharedRing {
+    _Alignas(RING_CACHE_LINE) _Atomic uint64_t writePosition;  // byte pubblicati dal produttore
+    _Atomic uint32_t dataSignal;        // futex: cambia quando arrivano dati
+    _Atomic uint32_t consumerWaiting;
+    _Atomic uint32_t closed;            // il produttore ha finito
+    _Alignas(RING_CACHE_LINE) _Atomic uint64_t readPosition;   // byte consumati dal consumatore
+    _Atomic uint32_t spaceSignal;       // futex: cambia quando si libera spazio
+    _Atomic uint32_t producerWaiting;
+    _Alignas(RING_CACHE_LINE) uint64_t capacity;               // potenza di due
+    unsigned char data[];
+} SharedRing;
+
+// stato locale del produttore: pubblica i byte scritti a blocchi
+typedef struct RingProducer {
+    SharedRing *ring;
+    uint64_t position;      // byte scritti, anche non ancora pubblicati
+    uint64_t published;
+    uint64_t limit;         // posizione massima scrivibile secondo l'ultima lettura di readPosition
+} RingProducer;
+
+// stato locale del consumatore: libera i byte letti a blocchi
+typedef struct RingConsumer {
+    SharedRing *ring;
+    uint64_t position;      // byte letti, anche non ancora liberati
+    uint64_t released;
+    uint64_t available;     // ultima writePosition letta
+} RingConsumer;
+
+// crea una coda condivisa di almeno capacity byte, da creare prima di fork
+SharedRing *ring_create(size_t capacity);
+
+// libera la memoria della coda
+void ring_destroy(SharedRing *ring);
+
+// inizializza il lato produttore
+void ring_producer_init(RingProducer *producer, SharedRing *ring);
+
+// scrive size byte, attendendo se la coda è piena
+void ring_write(RingProducer *producer, const void *data, size_t size);
+
+// rende visibili al consumatore i byte scritti
+void ring_flush(RingProducer *producer);
+
+// pubblica gli ultimi byte e segnala la fine dei dati
+void ring_close(RingProducer *producer);
+
+// inizializza il lato consumatore
+void ring_consumer_init(RingConsumer *consumer, SharedRing *ring);
+
+// legge fino a size byte, attendendo se la coda è vuota; ritorna meno di size solo a fine dati
+size_t ring_read(RingConsumer *consumer, void *data, size_t size);
+
+#endif // RING_H
@@ -0,0 +1,56 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// generatore pseudocasuale xoshiro256**
+// ogni thread usa il proprio stato; rng_jump separa i flussi di 2^128 estrazioni
+typedef struct Rng {
+    uint64_t state[4];
+} Rng;
+
+// inizializza lo stato a partire da un seme a 64 bit
+void rng_seed(Rng *rng, uint64_t seed);
+
+// avanza lo stato di 2^128 estrazioni, per ottenere un flusso indipendente
+void rng_jump(Rng *rng);
+
+// prepara count flussi indipendenti derivati dallo stesso seme
+void rng_split(uint64_t seed, Rng *streams, unsigned count);
+
+// seme predefinito, diverso a ogni esecuzione
+uint64_t rng_default_seed(void);
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// restituisce i prossimi 64 bit casuali
+static inline uint64_t rng_next(Rng *rng) {
+    uint64_t *s = rng->state;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+// restituisce un intero in [0, bound), bound > 0, senza distorsione (metodo di Lemire)
+// il prodotto a 64 bit sostituisce il modulo; il modulo serve solo nel raro caso in
+// cui la parte bassa del prodotto cade nella zona da scartare
+static inline uint32_t rng_below(Rng *rng, uint32_t bound) {
+    uint64_t product = (rng_next(rng) >> 32) * (uint64_t)bound;
+    if ((uint32_t)product < bound) {
+        uint32_t threshold = (uint32_t)-bound % bound;
+        while ((uint32_t)product < threshold) {
+            product = (rng_next(rng) >> 32) * (uint64_t)bound;
+        }
+    }
+    return (uint32_t)(product >> 32);
+}
+
+#endif // RNG_H
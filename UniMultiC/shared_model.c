@@ -0,0 +1,115 @@
+/*
+ * passaggio del modello di generazione tra processi tramite memoria condivisa
+ * il processo di analisi scrive il modello nel formato binario in un segmento
+ * POSIX; il formato usa solo offset relativi all'inizio del segmento, quindi il
+ * generatore lo mappa in sola lettura a qualsiasi indirizzo e lo usa così com'è,
+ * senza passare da un csv da scrivere e rileggere
+ */
+#include "shared_model.h"
+#include "binary_model.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * compone il nome del segmento condiviso, unico per ogni pipeline
+ *
+ * parametri
+ *   name: buffer che riceve il nome
+ *   size: dimensione del buffer
+ *   owner: pid del processo che coordina la pipeline
+ */
+void shared_model_name(char *name, size_t size, pid_t owner) {
+    snprintf(name, size, "/wordfreqgen-%ld", (long)owner);
+}
+
+/*
+ * crea il segmento condiviso e vi copia il modello nel formato binario
+ *
+ * parametri
+ *   name: nome del segmento, non deve esistere
+ *   model: modello da pubblicare
+ *
+ * ritorno
+ *   1 se il modello è stato pubblicato, 0 in caso di errore
+ */
+int publish_shared_model(const char *name, const GenerationModel *model) {
+    size_t size = binary_model_size(model);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        perror("Failed to create shared model");
+        return 0;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        perror("Failed to resize shared model");
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+
+    void *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map shared model");
+        shm_unlink(name);
+        return 0;
+    }
+    store_binary_model(model, data);
+    munmap(data, size);
+    return 1;
+}
+
+/*
+ * collega il modello al segmento condiviso, mappato in sola lettura
+ * il segmento resta mappato fino a free_generation_model
+ *
+ * parametri
+ *   name: nome del segmento
+ *   model: modello da inizializzare
+ *
+ * ritorno
+ *   1 se il modello è stato collegato, 0 in caso di errore
+ */
+int attach_shared_model(const char *name, GenerationModel *model) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror("Failed to open shared model");
+        return 0;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        fprintf(stderr, "Shared model is empty: %s\n", name);
+        close(fd);
+        return 0;
+    }
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Failed to map shared model");
+        return 0;
+    }
+
+    int attached = attach_binary_model(data, size, model);
+    if (attached != 1) {
+        fprintf(stderr, attached == BINARY_MODEL_UNSUPPORTED ? "Unsupported shared model version: %s\n"
+                                                             : "Corrupted shared model: %s\n", name);
+        munmap(data, size);
+        return 0;
+    }
+    model->mapping = data;
+    model->mappingSize = size;
+    return 1;
+}
+
+/*
+ * rimuove il nome del segmento; le mappature ancora aperte restano valide
+ */
+void remove_shared_model(const char *name) {
+    shm_unlink(name);
+}
@@ -0,0 +1,22 @@
+#ifndef SHARED_MODEL_H
+#define SHARED_MODEL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "generation_model.h"
+
+#define SHARED_MODEL_NAME_SIZE 64 // spazio per il nome di un segmento condiviso
+
+// compone il nome del segmento condiviso usato dalla pipeline di un processo
+void shared_model_name(char *name, size_t size, pid_t owner);
+
+// copia il modello in un nuovo segmento di memoria condivisa; ritorna 0 in caso di errore
+int publish_shared_model(const char *name, const GenerationModel *model);
+
+// collega il modello al segmento condiviso in sola lettura; ritorna 0 in caso di errore
+int attach_shared_model(const char *name, GenerationModel *model);
+
+// rimuove il nome del segmento condiviso
+void remove_shared_model(const char *name);
+
+#endif // SHARED_MODEL_H
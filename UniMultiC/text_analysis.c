@@ -1,188 +1,436 @@
 #include "text_analysis.h"
+#include "char_classes.h"
+#include "utf8.h"
+#include "csv_writer.h"
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdio.h>
 #include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define HASH_SIZE 997 // dimensione predefinita della tabella hash
+#define SCAN_SLICE_SIZE 4096 // byte classificati insieme da scan_text
+#define STREAM_BUFFER_SIZE (1024 * 1024) // blocco di lettura per pipe e standard input
 
 /*
- * determina se un carattere è valido per comporre una parola
- * accetta lettere dell'alfabeto e l'apostrofo
+ * inizializza una tabella di word table con una data dimensione
+ * le parole sono internate in uno StringPool e i nodi sono indicizzati per id,
+ * quindi size è solo una stima iniziale del numero di parole; parole e successori
+ * sono allocati dall'arena della tabella, che non va copiata dopo l'inizializzazione
  *
  * parametri
- *   c: carattere da valutare
+ *   table: puntatore alla struttura WordTable da inizializzare
+ *   size: numero di parole previsto
  *
  * ritorno
- *   restituisce 1 (true) se il carattere è una lettera o un apostrofo, altrimenti 0 (false)
+ *   nessun valore di ritorno esplicito
  */
-int is_valid_character(char c) {
-    return (isalpha(c) || (unsigned char)c >= 128);  // include l'apostrofo come parte di una parola
+void init_word_table(WordTable *table, size_t size) {
+    init_arena(&table->arena, WORD_TABLE_SLAB_SIZE);
+    init_string_pool(&table->words, size, &table->arena);
+    table->size = 0;
+    table->capacity = size > 0 ? size : 1;
+    table->nodes = malloc(table->capacity * sizeof(WordNode));
+    if (!table->nodes) {
+        fprintf(stderr, "Memory allocation failed for nodes\n");
+        exit(EXIT_FAILURE);
+    }
 }
 
 /*
- * formatta la frequenza in una stringa con precisione a quattro cifre decimali
+ * restituisce l'id di una parola, aggiungendola alla tabella se non esiste
+ * ogni parola viene copiata e ne viene calcolato l'hash una sola volta
  *
  * parametri
- *   frequency: valore float della frequenza da formattare
+ *   table: tabella delle parole
+ *   word: parola da internare
  *
  * ritorno
- *   restituisce una stringa contenente la frequenza formattata
+ *   l'id della parola, che indicizza table->nodes
+ */
+uint32_t word_table_intern(WordTable *table, const char *word) {
+    uint32_t id = intern_string(&table->words, word);
+    if (id >= table->size) {
+        if (id >= table->capacity) {
+            size_t capacity = table->capacity * 2;
+            WordNode *nodes = realloc(table->nodes, capacity * sizeof(WordNode));
+            if (!nodes) {
+                fprintf(stderr, "Memory allocation failed for nodes\n");
+                exit(EXIT_FAILURE);
+            }
+            table->nodes = nodes;
+            table->capacity = capacity;
+        }
+        memset(&table->nodes[id], 0, sizeof(WordNode));
+        table->size = id + 1;
+    }
+    return id;
+}
+
+/*
+ * inizializza il tokenizzatore incrementale
+ *
+ * parametri
+ *   scanner: tokenizzatore da inizializzare
+ *   table: tabella delle parole in cui registrare le coppie
+ */
+void init_text_scanner(TextScanner *scanner, WordTable *table) {
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->table = table;
+    scanner->lastWord = NO_STRING;
+    scanner->previousWord = NO_STRING;
+}
+
+/*
+ * registra una coppia di token consecutivi
+ * se il tokenizzatore ha una funzione di uscita la coppia viene inoltrata,
+ * altrimenti viene contata nella tabella
  */
-char *format_frequency(float frequency) {
-    static char formatted[10];
-    if (frequency >= 0.9999) {
-        sprintf(formatted, "1");
+static void scan_pair(TextScanner *scanner, uint32_t word, uint32_t next) {
+    if (scanner->emitPair) {
+        scanner->emitPair(scanner->emitContext, word, next);
     } else {
-        sprintf(formatted, "%.4f", frequency); // limita a quattro cifre decimali
+        add_word_ids(scanner->table, word, next, 1);
     }
-    return formatted;
 }
 
 /*
- * funzione hash per generare un indice basato sulla stringa data
+ * registra una parola completa letta dal testo
+ * la prima parola viene catturata al volo, senza riavvolgere l'input
  *
  * parametri
- *   str: stringa da cui generare l'hash
+ *   scanner: stato corrente del tokenizzatore
+ *   word: parola terminata da '\0', con le lettere ASCII già in minuscolo
+ */
+static void scan_word(TextScanner *scanner, char *word) {
+    if (scanner->foldWord) {
+        // la parola contiene caratteri non ASCII: le lettere accentate passano in minuscolo
+        utf8_fold(word, strlen(word));
+        scanner->foldWord = 0;
+    }
+    if (scanner->firstWord == NULL) {
+        scanner->firstWord = strdup(word);
+        if (!scanner->firstWord) {
+            fprintf(stderr, "Memory allocation failed for firstWord\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    uint32_t id = word_table_intern(scanner->table, word);
+    if (scanner->lastWord != NO_STRING) {
+        scan_pair(scanner, scanner->lastWord, id);
+    }
+    scanner->previousWord = id;
+    scanner->lastWord = id;
+}
+
+/*
+ * registra un segno di punteggiatura che termina una frase
+ * la punteggiatura viene collegata all'ultima parola vera e propria
  *
- * ritorno
- *   restituisce l'indice hash calcolato, che può essere utilizzato per localizzare un bucket in una tabella hash
+ * parametri
+ *   scanner: stato corrente del tokenizzatore
+ *   c: carattere di punteggiatura ('.', '?' o '!')
  */
-unsigned long hash(const char *str) {
-    unsigned long hash = 5381; // valore iniziale dell'hash
-    int c;
-    while ((c = *str++))
-        hash = ((hash << 5) + hash) + c;
-    return hash % HASH_SIZE;
+static void scan_punctuation(TextScanner *scanner, char c) {
+    char punct[2] = {c, '\0'};
+    uint32_t id = word_table_intern(scanner->table, punct);
+    if (scanner->previousWord == NO_STRING) {
+        // nessuna parola ancora vista: il collegamento dipende dal testo precedente
+        scanner->leadingPunctuation[c == '.' ? 0 : (c == '?' ? 1 : 2)]++;
+    } else {
+        scan_pair(scanner, scanner->previousWord, id);
+    }
+    scanner->lastWord = id;
 }
 
 /*
- * inizializza una tabella di word table con una data dimensione
- * alloca memoria per ciascun bucket della tabella
+ * aggiunge alla parola in costruzione un tratto di lettere già in minuscolo
+ * le lettere oltre la lunghezza massima vengono scartate, come prima; se il
+ * taglio cade dentro un carattere UTF-8 si scarta anche il suo inizio, così
+ * nel vocabolario non finiscono sequenze a metà
+ */
+static void scan_letters(TextScanner *scanner, const char *letters, size_t count) {
+    size_t room = sizeof(scanner->word) - 2 - (size_t)scanner->idx;
+    if (count > room) {
+        count = room;
+        while (count > 0 && ((unsigned char)letters[count] & 0xC0) == 0x80) {
+            count--;
+        }
+    }
+    memcpy(scanner->word + scanner->idx, letters, count);
+    scanner->idx += (int)count;
+}
+
+/*
+ * aggiunge alla parola i byte di una sequenza UTF-8 rimasta incompleta
+ * una sequenza interrotta non è valida: i suoi byte restano nella parola
+ * così come sono, come succede a ogni altro byte non valido
+ */
+static inline void flush_pending(TextScanner *scanner) {
+    if (scanner->pendingLength > 0) {
+        scan_letters(scanner, scanner->pending, (size_t)scanner->pendingLength);
+        scanner->pendingLength = 0;
+        scanner->foldWord = 1;
+    }
+}
+
+/*
+ * gestisce un delimitatore: chiude la parola in costruzione e registra
+ * l'eventuale punteggiatura di fine frase
  *
  * parametri
- *   table: puntatore alla struttura WordTable da inizializzare
- *   size: dimensione della tabella di hash (numero di buckets)
+ *   scanner: stato del tokenizzatore
+ *   c: spazio, apostrofo, '.', '?' o '!'
+ */
+static void scan_delimiter(TextScanner *scanner, char c) {
+    char *word = scanner->word;
+    flush_pending(scanner);
+    if (c == '\'') {
+        if (scanner->idx > 0) {
+            word[scanner->idx++] = c; // include l'apostrofo se è preceduto da una lettera
+            word[scanner->idx] = '\0';
+            scan_word(scanner, word);
+            scanner->idx = 0;
+        }
+        return;
+    }
+    if (scanner->idx > 0) {
+        word[scanner->idx] = '\0';
+        scan_word(scanner, word);
+        scanner->idx = 0;
+    }
+    if (c == '.' || c == '?' || c == '!') {
+        scan_punctuation(scanner, c);
+    }
+}
+
+/*
+ * ruolo di un carattere non ASCII nel testo
+ * l'apostrofo tipografico vale come quello ASCII, così "l’uomo" e "l'uomo"
+ * danno gli stessi token; virgolette, puntini di sospensione, trattini e spazio
+ * non separabile separano le parole; tutti gli altri caratteri sono lettere
  *
  * ritorno
- *   nessun valore di ritorno esplicito
+ *   '\'' per l'apostrofo, ' ' per un separatore, 0 per una lettera
  */
-void init_word_table(WordTable *table, size_t size) {
-    printf("size %zu", size);
-    table->size = size;
-    table->buckets = malloc(size * sizeof(WordNode*)); // alloca memoria per i buckets
-    if (!table->buckets) {
-        fprintf(stderr, "Memory allocation failed for buckets\n");
-        exit(EXIT_FAILURE);
+static char unicode_delimiter(uint32_t codePoint) {
+    switch (codePoint) {
+    case 0x2019: // ’
+        return '\'';
+    case 0x00A0: // spazio non separabile
+    case 0x00AB: // «
+    case 0x00BB: // »
+    case 0x2013: // –
+    case 0x2014: // —
+    case 0x2018: // ‘
+    case 0x201C: // “
+    case 0x201D: // ”
+    case 0x2026: // …
+        return ' ';
+    default:
+        return 0;
+    }
+}
+
+/*
+ * gestisce un byte >= 128
+ * i byte vengono raccolti finché la sequenza UTF-8 è completa, anche a cavallo
+ * di due blocchi, poi il carattere decodificato diventa un delimitatore o una
+ * lettera della parola. I byte che non formano una sequenza valida restano
+ * lettere, come nel resto del tokenizzatore
+ *
+ * parametri
+ *   scanner: stato del tokenizzatore
+ *   c: byte da 0x80 a 0xFF
+ */
+static void scan_high_byte(TextScanner *scanner, unsigned char c) {
+    if (scanner->pendingLength > 0 && (c & 0xC0) == 0x80) {
+        scanner->pending[scanner->pendingLength++] = (char)c;
+    } else {
+        flush_pending(scanner);
+        size_t length = utf8_sequence_length(c);
+        if (length == 1) {
+            scan_letters(scanner, (const char *)&c, 1); // byte isolato, non decodificabile
+            scanner->foldWord = 1;
+            return;
+        }
+        scanner->pending[0] = (char)c;
+        scanner->pendingLength = 1;
+        scanner->pendingExpected = (int)length;
     }
-    for (size_t i = 0; i < size; i++) {
-        table->buckets[i] = NULL;
+    if (scanner->pendingLength < scanner->pendingExpected) {
+        return;
+    }
+
+    uint32_t codePoint;
+    utf8_decode(scanner->pending, (size_t)scanner->pendingLength, &codePoint);
+    char delimiter = codePoint == UTF8_INVALID ? 0 : unicode_delimiter(codePoint);
+    if (delimiter) {
+        scanner->pendingLength = 0;
+        scan_delimiter(scanner, delimiter);
+    } else {
+        flush_pending(scanner); // lettera, o sequenza non valida lasciata com'è
     }
-    printf("size %zu,%p", table->size, (void*)table->buckets);
 }
 
 /*
- * analizza il testo da un file di input, estraendo e processando ogni parola
- * gestisce la prima e l'ultima parola per eventuali collegamenti iniziali e finali
+ * aggiunge alla parola un tratto di lettere che contiene byte >= 128
+ * i tratti ASCII vengono copiati interi, i byte alti passano da scan_high_byte
  *
  * parametri
- *   inputFile: puntatore al file da cui leggere il testo
- *   table: puntatore alla tabella delle parole per memorizzare le frequenze
- *   firstWord: doppio puntatore alla prima parola del testo
- *   lastWord: doppio puntatore all'ultima parola processata
+ *   scanner: stato del tokenizzatore
+ *   letters: lettere, già in minuscolo quelle ASCII
+ *   count: numero di byte del tratto
+ */
+static void scan_mixed_letters(TextScanner *scanner, const char *letters, size_t count) {
+    size_t i = 0;
+    while (i < count) {
+        if ((unsigned char)letters[i] >= 0x80) {
+            scan_high_byte(scanner, (unsigned char)letters[i]);
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        while (end < count && (unsigned char)letters[end] < 0x80) {
+            end++;
+        }
+        flush_pending(scanner);
+        scan_letters(scanner, letters + i, end - i);
+        i = end;
+    }
+}
+
+/*
+ * indice del bit meno significativo a 1; mask non deve essere zero
+ */
+static inline int lowest_bit(uint64_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int index = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+/*
+ * analizza un blocco di 64 byte già classificato
+ * le lettere tra due delimitatori vengono copiate a tratti contigui; i byte che
+ * non sono né lettere né delimitatori vengono saltati senza spezzare la parola.
+ * Solo i tratti con byte >= 128 vengono decodificati, per riconoscere la
+ * punteggiatura tipografica che il classificatore non distingue dalle lettere;
+ * una sequenza UTF-8 interrotta da un byte saltato non viene ricomposta
  *
- * ritorno
- *   nessun valore di ritorno; i risultati sono memorizzati direttamente nelle strutture dati fornite
+ * parametri
+ *   scanner: stato del tokenizzatore
+ *   text: byte originali del blocco
+ *   lowered: byte del blocco con le lettere in minuscolo
+ *   size: byte validi del blocco, da 1 a CLASS_BLOCK_SIZE
+ *   letters, delimiters, highBytes: maschere del blocco
  */
-void analyze_text(FILE *inputFile, WordTable *table, char **firstWord, char **lastWord) {
-    char word[256] = {0};
-    char c;
-    int idx = 0;
-    *firstWord = find_first_word(inputFile);
-    *lastWord = NULL;
-    char previousWord[256] = {0};
-
-    while ((c = fgetc(inputFile)) != EOF) {
-        if (is_valid_character(c)) {
-            word[idx++] = tolower((unsigned char)c); // aggiunge il carattere alla parola in minuscolo
-        } else if (c == '\'') {
-            if (idx > 0) {
-                word[idx++] = c; // include l'apostrofo se è preceduto da una lettera
-                word[idx] = '\0';
-                if (*firstWord == NULL) {
-                    *firstWord = strdup(word);
-                    if (!*firstWord) {
-                        fprintf(stderr, "Memory allocation failed for firstWord\n");
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                if (*lastWord != NULL) {
-                    add_word(table, *lastWord, word);
-                }
-                strcpy(previousWord, word);
-                free(*lastWord);
-                *lastWord = strdup(word);
-                if (!*lastWord) {
-                    fprintf(stderr, "Memory allocation failed for lastWord\n");
-                    exit(EXIT_FAILURE);
-                }
-                idx = 0;
-            }
-        } else if (!isspace(c) && c != '.' && c != '?' && c != '!') {
-            // Ignora altri caratteri non validi per delimitare le parole
-        } else {
-            if (idx > 0) {
-                word[idx] = '\0';
-                if (*firstWord == NULL) {
-                    *firstWord = strdup(word);
-                    if (!*firstWord) {
-                        fprintf(stderr, "Memory allocation failed for firstWord\n");
-                        exit(EXIT_FAILURE);
-                    }
-                }
-                if (*lastWord != NULL) {
-                    add_word(table, *lastWord, word);
-                }
-                strcpy(previousWord, word);
-                free(*lastWord);
-                *lastWord = strdup(word);
-                if (!*lastWord) {
-                    fprintf(stderr, "Memory allocation failed for lastWord\n");
-                    exit(EXIT_FAILURE);
-                }
-                idx = 0;
-            }
-            if (c == '.' || c == '?' || c == '!') {
-                word[0] = c;
-                word[1] = '\0';
-                if (*lastWord != NULL) {
-                    add_word(table, previousWord, word);
-                }
-                free(*lastWord);
-                *lastWord = strdup(word);
-                if (!*lastWord) {
-                    fprintf(stderr, "Memory allocation failed for lastWord\n");
-                    exit(EXIT_FAILURE);
+static void scan_block(TextScanner *scanner, const char *text, const char *lowered, size_t size,
+                       uint64_t letters, uint64_t delimiters, uint64_t highBytes) {
+    uint64_t wordBytes = letters;
+    for (;;) {
+        // lettere che precedono il prossimo delimitatore
+        uint64_t before = delimiters ? (delimiters & (0 - delimiters)) - 1 : ~(uint64_t)0;
+        uint64_t run = letters & before;
+        letters &= ~before;
+        while (run) {
+            int start = lowest_bit(run);
+            uint64_t next = run + (run & (0 - run)); // azzera il tratto di bit a 1 più basso
+            int end = next ? lowest_bit(next) : CLASS_BLOCK_SIZE;
+            if ((run & ~next) & highBytes) {
+                // il tratto contiene caratteri UTF-8 non ASCII: vanno decodificati
+                if (start > 0 && !((wordBytes >> (start - 1)) & 1)) {
+                    flush_pending(scanner);
                 }
+                scan_mixed_letters(scanner, lowered + start, (size_t)(end - start));
+            } else {
+                flush_pending(scanner);
+                scan_letters(scanner, lowered + start, (size_t)(end - start));
             }
+            run &= next;
         }
-    }
 
-    if (idx > 0) {
-        word[idx] = '\0';
-        if (*firstWord == NULL) {
-            *firstWord = strdup(word);
-            if (!*firstWord) {
-                fprintf(stderr, "Memory allocation failed for firstWord\n");
-                exit(EXIT_FAILURE);
+        if (!delimiters) {
+            // il blocco finisce con byte saltati: la sequenza in sospeso non prosegue nel successivo
+            if (!((wordBytes >> (size - 1)) & 1)) {
+                flush_pending(scanner);
             }
+            return;
         }
-        if (*lastWord != NULL) {
-            add_word(table, *lastWord, word);
+        int position = lowest_bit(delimiters);
+        delimiters &= delimiters - 1;
+        scan_delimiter(scanner, text[position]);
+    }
+}
+
+/*
+ * analizza un blocco di testo, proseguendo dallo stato lasciato dal blocco precedente
+ * una parola spezzata tra due blocchi viene ricomposta correttamente.
+ * Il testo viene classificato a tratti di SCAN_SLICE_SIZE byte con le istruzioni
+ * vettoriali disponibili, poi i token si ricavano dalle maschere dei caratteri
+ *
+ * parametri
+ *   scanner: stato del tokenizzatore
+ *   data: puntatore ai byte del blocco
+ *   size: numero di byte del blocco
+ */
+void scan_text(TextScanner *scanner, const char *data, size_t size) {
+    char lowered[SCAN_SLICE_SIZE];
+    uint64_t letters[SCAN_SLICE_SIZE / CLASS_BLOCK_SIZE];
+    uint64_t delimiters[SCAN_SLICE_SIZE / CLASS_BLOCK_SIZE];
+    uint64_t highBytes[SCAN_SLICE_SIZE / CLASS_BLOCK_SIZE];
+    CharClasses classes = {letters, delimiters, highBytes, lowered};
+
+    for (size_t offset = 0; offset < size; offset += SCAN_SLICE_SIZE) {
+        size_t length = size - offset < SCAN_SLICE_SIZE ? size - offset : SCAN_SLICE_SIZE;
+        classify_text(data + offset, length, &classes);
+        for (size_t block = 0; block * CLASS_BLOCK_SIZE < length; block++) {
+            size_t start = block * CLASS_BLOCK_SIZE;
+            size_t blockSize = length - start < CLASS_BLOCK_SIZE ? length - start : CLASS_BLOCK_SIZE;
+            scan_block(scanner, data + offset + start, lowered + start, blockSize, letters[block],
+                       delimiters[block], highBytes[block]);
         }
-        free(*lastWord);
-        *lastWord = strdup(word);
+    }
+}
+
+/*
+ * chiude l'analisi registrando l'eventuale parola rimasta in sospeso
+ *
+ * parametri
+ *   scanner: stato del tokenizzatore
+ */
+void finish_text_scanner(TextScanner *scanner) {
+    flush_pending(scanner);
+    if (scanner->idx > 0) {
+        scanner->word[scanner->idx] = '\0';
+        scan_word(scanner, scanner->word);
+        scanner->idx = 0;
+    }
+}
+
+/*
+ * conclude un'analisi completa: registra la parola in sospeso, restituisce la
+ * prima parola e l'ultimo token e collega l'ultimo token alla prima parola
+ *
+ * parametri
+ *   scanner: tokenizzatore che ha letto tutto il testo
+ *   firstWord: riceve la prima parola del testo (da liberare con free)
+ *   lastWord: riceve l'ultimo token del testo (da liberare con free)
+ */
+static void finish_analysis(TextScanner *scanner, char **firstWord, char **lastWord) {
+    WordTable *table = scanner->table;
+    finish_text_scanner(scanner);
+
+    *firstWord = scanner->firstWord;
+    *lastWord = NULL;
+    if (scanner->lastWord != NO_STRING) {
+        *lastWord = strdup(pool_string(&table->words, scanner->lastWord));
         if (!*lastWord) {
             fprintf(stderr, "Memory allocation failed for lastWord\n");
             exit(EXIT_FAILURE);
@@ -195,6 +443,168 @@ void analyze_text(FILE *inputFile, WordTable *table, char **firstWord, char **la
     }
 }
 
+/*
+ * analizza un testo gia' presente in memoria in un'unica passata
+ * applica le stesse regole di analyze_text, ma lavora direttamente sui byte
+ * del buffer senza passare da stdio
+ *
+ * parametri
+ *   data: puntatore ai byte del testo
+ *   size: numero di byte da analizzare
+ *   table: tabella delle parole da popolare
+ *   firstWord: riceve la prima parola del testo (da liberare con free)
+ *   lastWord: riceve l'ultimo token del testo (da liberare con free)
+ */
+void analyze_buffer(const char *data, size_t size, WordTable *table, char **firstWord, char **lastWord) {
+    TextScanner scanner;
+    init_text_scanner(&scanner, table);
+    scan_text(&scanner, data, size);
+    finish_analysis(&scanner, firstWord, lastWord);
+}
+
+/*
+ * prova a leggere il file mappandolo in memoria
+ * funziona solo per file regolari: pipe e terminali non sono mappabili
+ *
+ * parametri
+ *   inputFile: file da analizzare, a partire dalla posizione corrente
+ *   scanner: tokenizzatore che riceve il testo
+ *
+ * ritorno
+ *   1 se il testo è stato letto, 0 se serve il percorso basato su FILE*
+ */
+static int scan_mapped_file(FILE *inputFile, TextScanner *scanner) {
+    int fd = fileno(inputFile);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return 0;
+    }
+
+    long offset = ftell(inputFile);
+    if (offset < 0 || offset > st.st_size) {
+        return 0;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size == (size_t)offset) {
+        return 1; // file vuoto: nessuna parola da analizzare
+    }
+
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    madvise(data, size, MADV_SEQUENTIAL); // la lettura è strettamente sequenziale
+    madvise(data, size, MADV_WILLNEED);
+
+    scan_text(scanner, (const char *)data + offset, size - (size_t)offset);
+
+    munmap(data, size);
+    fseek(inputFile, 0, SEEK_END); // il contenuto è stato consumato
+    return 1;
+}
+
+/*
+ * legge un flusso che non si può mappare, come una pipe o lo standard input
+ * il testo viene letto una sola volta in blocchi di STREAM_BUFFER_SIZE byte e
+ * passato al tokenizzatore, che ricompone le parole spezzate tra due blocchi e
+ * ricorda prima parola e ultimo token: non serve riavvolgere l'input e la
+ * memoria usata non dipende dalla lunghezza del flusso
+ *
+ * parametri
+ *   inputFile: flusso da analizzare, a partire dalla posizione corrente
+ *   scanner: tokenizzatore che riceve il testo
+ */
+static void scan_stream(FILE *inputFile, TextScanner *scanner) {
+    char *buffer = malloc(STREAM_BUFFER_SIZE);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for input buffer\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, STREAM_BUFFER_SIZE, inputFile)) > 0) {
+        scan_text(scanner, buffer, bytesRead);
+    }
+    if (ferror(inputFile)) {
+        perror("Failed to read input file");
+    }
+    free(buffer);
+}
+
+/*
+ * passa al tokenizzatore tutto il testo del file
+ * i file regolari vengono mappati in memoria, pipe e stream letti a blocchi
+ */
+static void scan_file(FILE *inputFile, TextScanner *scanner) {
+    if (!scan_mapped_file(inputFile, scanner)) {
+        scan_stream(inputFile, scanner);
+    }
+}
+
+/*
+ * analizza il testo da un file di input, estraendo e processando ogni parola
+ * gestisce la prima e l'ultima parola per eventuali collegamenti iniziali e finali
+ * i file regolari vengono mappati in memoria e analizzati in un'unica passata,
+ * pipe e stream vengono letti a blocchi di dimensione fissa, sempre in un'unica passata
+ *
+ * parametri
+ *   inputFile: puntatore al file da cui leggere il testo
+ *   table: puntatore alla tabella delle parole per memorizzare le frequenze
+ *   firstWord: doppio puntatore alla prima parola del testo
+ *   lastWord: doppio puntatore all'ultima parola processata
+ *
+ * ritorno
+ *   nessun valore di ritorno; i risultati sono memorizzati direttamente nelle strutture dati fornite
+ */
+void analyze_text(FILE *inputFile, WordTable *table, char **firstWord, char **lastWord) {
+    TextScanner scanner;
+    init_text_scanner(&scanner, table);
+    scan_file(inputFile, &scanner);
+    finish_analysis(&scanner, firstWord, lastWord);
+}
+
+/*
+ * indica se un token è una punteggiatura di fine frase
+ */
+static int is_sentence_end(const char *token) {
+    return (token[0] == '.' || token[0] == '?' || token[0] == '!') && token[1] == '\0';
+}
+
+/*
+ * prosegue l'analisi di un testo già contato nella tabella con un nuovo testo
+ * il tokenizzatore riparte come se il nuovo testo seguisse il vecchio dopo un
+ * a capo: il primo token nuovo si collega all'ultimo vecchio e alla fine
+ * l'ultimo token si collega alla prima parola del vecchio testo. La tabella
+ * non deve contenere la coppia (ultimo, prima) del vecchio testo.
+ * Il tokenizzatore non conosce l'ultima parola vera del vecchio testo: se
+ * questo termina con una punteggiatura, quella che precede la prima parola
+ * nuova resta scollegata, come all'inizio di un testo
+ *
+ * parametri
+ *   inputFile: file con il nuovo testo
+ *   table: tabella con i conteggi del vecchio testo
+ *   firstWord: prima parola del vecchio testo (NULL se non c'è), poi quella del
+ *              testo unito; resta di proprietà del chiamante
+ *   lastWord: ultimo token del vecchio testo (NULL se non c'è), sostituito con
+ *             quello del testo unito; il valore precedente viene liberato
+ */
+void continue_analysis(FILE *inputFile, WordTable *table, char **firstWord, char **lastWord) {
+    TextScanner scanner;
+    init_text_scanner(&scanner, table);
+    scanner.firstWord = *firstWord;
+    if (*lastWord) {
+        scanner.lastWord = word_table_intern(table, *lastWord);
+        if (!is_sentence_end(*lastWord)) {
+            scanner.previousWord = scanner.lastWord;
+        }
+        free(*lastWord);
+    }
+
+    scan_file(inputFile, &scanner);
+    finish_analysis(&scanner, firstWord, lastWord);
+}
+
 /*
  * calcola e assegna le frequenze relative per tutti i successori di un dato nodo
  * le frequenze relative sono calcolate come il rapporto tra la frequenza di un successore
@@ -209,20 +619,118 @@ void analyze_text(FILE *inputFile, WordTable *table, char **firstWord, char **la
  *
  */
 void calculate_relative_frequencies(WordNode *node) {
-    if (!node || !node->successors) return;
+    if (!node || node->successorCount == 0) return;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < node->successorCount; i++) {
+        total += node->successors[i].frequency; // somma tutte le frequenze dei successori
+    }
 
-    SuccessorNode *snode = node->successors;
-    //printf("%s",snode->word);
-    int total = 0;
-    while (snode) {
-        total += snode->frequency; // somma tutte le frequenze dei successori
-        snode = snode->next;
+    for (uint32_t i = 0; i < node->successorCount; i++) {
+        node->successors[i].relative_frequency = (float) node->successors[i].frequency / total; // calcola la frequenza relativa
     }
+}
+
+/*
+ * posizione iniziale di un id nell'indice dei successori
+ */
+static inline uint32_t successor_slot(uint32_t word, uint32_t indexSize) {
+    uint32_t h = word * 0x9E3779B1u;
+    return (h ^ (h >> 16)) & (indexSize - 1);
+}
+
+/*
+ * cerca un successore di una parola
+ * sotto la soglia l'array viene scorso confrontando interi, oltre la soglia
+ * si usa l'indice hash del nodo
+ *
+ * parametri
+ *   node: nodo della parola
+ *   next_word: id del successore cercato
+ *
+ * ritorno
+ *   il successore oppure NULL se non è presente
+ */
+static SuccessorNode *find_successor(WordNode *node, uint32_t next_word) {
+    if (!node->successorIndex) {
+        for (uint32_t i = 0; i < node->successorCount; i++) {
+            if (node->successors[i].word == next_word) {
+                return &node->successors[i];
+            }
+        }
+        return NULL;
+    }
+
+    uint32_t mask = node->indexSize - 1;
+    for (uint32_t i = successor_slot(next_word, node->indexSize); node->successorIndex[i]; i = (i + 1) & mask) {
+        SuccessorNode *snode = &node->successors[node->successorIndex[i] - 1];
+        if (snode->word == next_word) {
+            return snode;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * inserisce nell'indice il successore in una data posizione dell'array
+ */
+static void index_successor(WordNode *node, uint32_t position) {
+    uint32_t mask = node->indexSize - 1;
+    uint32_t i = successor_slot(node->successors[position].word, node->indexSize);
+    while (node->successorIndex[i]) {
+        i = (i + 1) & mask;
+    }
+    node->successorIndex[i] = position + 1;
+}
+
+/*
+ * costruisce (o ricostruisce più grande) l'indice hash dei successori
+ * l'indice ha sempre almeno il doppio degli slot rispetto ai successori
+ */
+static void build_successor_index(WordTable *table, WordNode *node) {
+    if (node->successorIndex) {
+        arena_release_block(&table->arena, node->successorIndex, node->indexSize * sizeof(uint32_t));
+    }
+    uint32_t size = 64;
+    while (size < node->successorCapacity * 2) {
+        size <<= 1;
+    }
+    node->successorIndex = arena_alloc_block(&table->arena, size * sizeof(uint32_t));
+    memset(node->successorIndex, 0, size * sizeof(uint32_t));
+    node->indexSize = size;
+    for (uint32_t i = 0; i < node->successorCount; i++) {
+        index_successor(node, i);
+    }
+}
+
+/*
+ * dimensione in byte del blocco che contiene capacity successori
+ * i blocchi sono potenze di due per poter essere riciclati dall'arena
+ */
+static size_t successor_block_size(uint32_t capacity) {
+    size_t size = 32;
+    while (size < (size_t)capacity * sizeof(SuccessorNode)) {
+        size <<= 1;
+    }
+    return size;
+}
 
-    snode = node->successors;
-    while (snode) {
-        snode->relative_frequency = (float) snode->frequency / total; // calcola la frequenza relatia
-        snode = snode->next;
+/*
+ * raddoppia lo spazio per i successori di una parola
+ * il blocco vecchio torna all'arena per essere riusato da altre parole
+ */
+static void grow_successors(WordTable *table, WordNode *node) {
+    size_t oldSize = node->successorCapacity ? successor_block_size(node->successorCapacity) : 0;
+    size_t newSize = oldSize ? oldSize * 2 : 32;
+    SuccessorNode *successors = arena_alloc_block(&table->arena, newSize);
+    if (oldSize) {
+        memcpy(successors, node->successors, node->successorCount * sizeof(SuccessorNode));
+        arena_release_block(&table->arena, node->successors, oldSize);
+    }
+    node->successors = successors;
+    node->successorCapacity = (uint32_t)(newSize / sizeof(SuccessorNode));
+    if (node->successorIndex && node->successorCapacity * 2 > node->indexSize) {
+        build_successor_index(table, node);
     }
 }
 
@@ -238,57 +746,62 @@ void calculate_relative_frequencies(WordNode *node) {
  *   nessun valore di ritorno esplicito. la funzione aggiorna la tabella delle frequenze
  */
 void add_word(WordTable *table, const char *word, const char *next_word) {
-    if (word == NULL || next_word == NULL) return;
-
-    //printf("%s %s",word, next_word);
+    add_word_count(table, word, next_word, 1);
+}
 
-    unsigned long index = hash(word); // calcola l'indice hash per la parola
-    WordNode *node = table->buckets[index];
+/*
+ * aggiunge una coppia di parole con un numero arbitrario di occorrenze
+ * usata per unire tabelle costruite separatamente
+ *
+ * parametri
+ *   table: Puntatore alla tabella delle parole
+ *   word: Parola corrente
+ *   next_word: Prossima parola dopo la corrente
+ *   count: numero di occorrenze della coppia
+ */
+void add_word_count(WordTable *table, const char *word, const char *next_word, uint32_t count) {
+    if (word == NULL || next_word == NULL || count == 0) return;
 
-    while (node != NULL && strcmp(node->word, word) != 0) {
-        node = node->next;
-    }
-    if (node == NULL) {
-        node = malloc(sizeof(WordNode));
-        if (!node) {
-            fprintf(stderr, "Memory allocation failed for WordNode\n");
-            exit(EXIT_FAILURE);
-        }
-        node->word = strdup(word);
-        if (!node->word) {
-            fprintf(stderr, "Memory allocation failed for word in WordNode\n");
-            exit(EXIT_FAILURE);
-        }
-        node->successors = NULL;
-        node->next = table->buckets[index];
-        table->buckets[index] = node;
-    }
+    uint32_t id = word_table_intern(table, word);
+    uint32_t next_id = word_table_intern(table, next_word);
+    add_word_ids(table, id, next_id, count);
+}
 
-    SuccessorNode *snode = node->successors;
-    while (snode != NULL && strcmp(snode->word, next_word) != 0) {
-        snode = snode->next;
-    }
+/*
+ * aggiunge una coppia di parole già internate nella tabella
+ * i successori sono confrontati per id, senza strcmp
+ *
+ * parametri
+ *   table: Puntatore alla tabella delle parole
+ *   word: id della parola corrente
+ *   next_word: id della parola successiva
+ *   count: numero di occorrenze della coppia
+ */
+void add_word_ids(WordTable *table, uint32_t word, uint32_t next_word, uint32_t count) {
+    WordNode *node = &table->nodes[word];
+    SuccessorNode *snode = find_successor(node, next_word);
     if (snode == NULL) {
-        snode = malloc(sizeof(SuccessorNode));
-        if (!snode) {
-            fprintf(stderr, "Memory allocation failed for SuccessorNode\n");
-            exit(EXIT_FAILURE);
+        if (node->successorCount == node->successorCapacity) {
+            grow_successors(table, node);
         }
-        snode->word = strdup(next_word);
-        if (!snode->word) {
-            fprintf(stderr, "Memory allocation failed for word in SuccessorNode\n");
-            exit(EXIT_FAILURE);
+        snode = &node->successors[node->successorCount];
+        snode->word = next_word;
+        snode->frequency = count;
+        node->successorCount++;
+        if (node->successorIndex) {
+            index_successor(node, node->successorCount - 1);
+        } else if (node->successorCount > SUCCESSOR_INDEX_THRESHOLD) {
+            build_successor_index(table, node);
         }
-        snode->frequency = 1;
-        snode->next = node->successors;
-        node->successors = snode;
     } else {
-        snode->frequency++; // incrementa la frequenza del successore
+        snode->frequency += count; // incrementa la frequenza del successore
     }
 }
 
 /*
  * libera tutte le risorse allocate dalla tabella delle parole
+ * parole e successori vivono nell'arena, che si libera un blocco alla volta
+ * senza visitare i singoli nodi
  *
  * parametri
  *   table: Puntatore alla tabella delle parole da liberare
@@ -297,150 +810,117 @@ void add_word(WordTable *table, const char *word, const char *next_word) {
  *   nessun valore di ritorno. la funzione ha il compito di liberare la memoria
  */
 void free_word_table(WordTable *table) {
-    for (size_t i = 0; i < table->size; i++) {
-        WordNode *node = table->buckets[i];
-        while (node) {
-            WordNode *tmp = node;
-            node = node->next;
-
-            SuccessorNode *snode = tmp->successors;
-            while (snode) {
-                SuccessorNode *stmp = snode;
-                snode = snode->next;
-                free(stmp->word);
-                free(stmp);
-            }
+    free(table->nodes);
+    free_string_pool(&table->words);
+    free_arena(&table->arena);
+    table->nodes = NULL;
+    table->size = 0;
+    table->capacity = 0;
+}
 
-            free(tmp->word);
-            free(tmp);
-        }
-    }
-    free(table->buckets);
+/*
+ * legge le statistiche dell'allocatore della tabella
+ *
+ * parametri
+ *   table: tabella delle parole
+ *   stats: riceve byte riservati, byte usati e numero di blocchi dell'arena
+ */
+void get_word_table_stats(const WordTable *table, ArenaStats *stats) {
+    get_arena_stats(&table->arena, stats);
 }
 
 /*
- * stampa la tabella delle parole e delle frequenze relative su un file
+ * scrive le righe della tabella: parola seguita dalle coppie (successiva, valore)
+ * le righe sono composte da un CsvWriter: le parole vengono copiate con la
+ * lunghezza calcolata una volta per id e i valori formattati senza sprintf
  *
  * parametri
- *   table: Puntatore alla tabella delle parole
- *   file: Puntatore al file su cui scrivere
- *   firstWord: Prima parola del testo per uso specifico nel formato di output
+ *   table: tabella delle parole
+ *   file: file di destinazione
+ *   counts: 1 per scrivere i conteggi esatti, 0 per le frequenze relative
  *
  * ritorno
- *   nessun valore di ritorno. i risultati sono direttamente scritti sul file fornito
+ *   0 se tutte le scritture sono riuscite, -1 altrimenti
  */
-void print_word_table(const WordTable *table, FILE *file, const char *firstWord) {
-    for (size_t i = 0; i < table->size; i++) {
-        WordNode *node = table->buckets[i];
-        while (node) {
-            calculate_relative_frequencies(node); // calcola le frequenze relative per i successori del nodo
-            SuccessorNode *snode = node->successors;
-            if (snode) {
-                fprintf(file, "%s", node->word);
-                printf("Node: %s\n", node->word);  // Debug: mostra la parola corrente
-                while (snode) {
-                    fprintf(file, ",%s,%s", snode->word, format_frequency(snode->relative_frequency));
-                    printf("Successor: %s, Frequency: %s\n", snode->word, format_frequency(snode->relative_frequency));  // Debug: mostra il successore e la frequenza
-                    snode = snode->next;
-                }
-                fprintf(file, "\n");
-            }
-            node = node->next;
-        }
+static int print_word_rows(const WordTable *table, FILE *file, int counts) {
+    size_t *lengths = malloc((table->words.count + 1) * sizeof(size_t));
+    if (!lengths) {
+        fprintf(stderr, "Memory allocation failed for word lengths\n");
+        exit(EXIT_FAILURE);
     }
-    fflush(file);  // Ensure all data is written to the file
-}
-
-
-char* find_first_word(FILE *file) {
-    char buffer[256];
-    char *token = NULL;
-    char *first = NULL;
-
-    while (fgets(buffer, sizeof(buffer), file) != NULL) {
-        token = strtok(buffer, " \t\n");
-        while (token != NULL) {
-            char temp[256];
-            int idx = 0;
-            for (int i = 0; token[i] != '\0'; i++) {
-                if (token[i] == '\'') {
-                    temp[idx++] = token[i];
-                    temp[idx] = '\0';
-                    first = malloc(strlen(temp) + 1);
-                    if (first != NULL) {
-                        strcpy(first, temp);
-                        for (char *p = first; *p; ++p) {
-                            *p = tolower((unsigned char)*p);
-                        }
-                        rewind(file);
-                        return first;
-                    } else {
-                        fprintf(stderr, "Allocazione memoria fallita\n");
-                        exit(EXIT_FAILURE);
-                    }
-                } else {
-                    temp[idx++] = token[i];
-                }
-            }
-            if (idx > 0) {
-                temp[idx] = '\0';
-                first = malloc(strlen(temp) + 1);
-                if (first != NULL) {
-                    strcpy(first, temp);
-                    for (char *p = first; *p; ++p) {
-                        *p = tolower((unsigned char)*p);
-                    }
-                    rewind(file);
-                    return first;
-                } else {
-                    fprintf(stderr, "Allocazione memoria fallita\n");
-                    exit(EXIT_FAILURE);
-                }
-            }
-            token = strtok(NULL, " \t\n");
-        }
+    for (uint32_t id = 0; id < table->words.count; id++) {
+        lengths[id] = strlen(pool_string(&table->words, id));
     }
-    rewind(file);
-    return first;
-}
 
-char* find_last_token(FILE *file) {
-    char *token;
-    char *last = NULL;
-    char buffer[30];
+    CsvWriter writer;
+    init_csv_writer(&writer, file);
+    char value[CSV_COUNT_SIZE > CSV_FREQUENCY_SIZE ? CSV_COUNT_SIZE : CSV_FREQUENCY_SIZE];
+    for (size_t i = 0; i < table->size; i++) {
+        WordNode *node = &table->nodes[i];
+        if (node->successorCount == 0) continue;
 
-    // cerchiamo la parola
-    while (fgets(buffer, sizeof(buffer), file) != NULL) {
-        token = strtok(buffer, " \t\n");
-        while (token != NULL) {
-            free(last); // libera la memoria precedentemente allocata
-            size_t len = strlen(token);
-            last = malloc(len + 1);
-            if (last != NULL) {
-                strcpy(last, token);
-            } else {
-                fprintf(stderr, "allocazione memoria fallita\n");
-                exit(EXIT_FAILURE);
-            }
-            token = strtok(NULL, " \t\n");
+        if (!counts) {
+            calculate_relative_frequencies(node); // calcola le frequenze relative per i successori del nodo
         }
-    }
-
-    // altrimenti la punteggiatura
-    if (last != NULL && ispunct(last[strlen(last) - 1])) {
-        char* punct = malloc(2);
-        if (punct == NULL) {
-            fprintf(stderr, "allocazione memoria fallita\n");
-            exit(EXIT_FAILURE);
+        csv_write(&writer, pool_string(&table->words, (uint32_t)i), lengths[i]);
+        for (uint32_t j = 0; j < node->successorCount; j++) {
+            const SuccessorNode *snode = &node->successors[j];
+            csv_put(&writer, ',');
+            csv_write(&writer, pool_string(&table->words, snode->word), lengths[snode->word]);
+            csv_put(&writer, ',');
+            size_t length = counts ? format_csv_count(snode->frequency, value)
+                                   : format_csv_frequency(snode->relative_frequency, value);
+            csv_write(&writer, value, length);
         }
-        punct[0] = last[strlen(last) - 1];
-        punct[1] = '\0';
-        free(last);
-        last = punct;
+        csv_put(&writer, '\n');
     }
+    int status = close_csv_writer(&writer);
+    free(lengths);
+    return status;
+}
 
-    rewind(file); // riavvolge il file per permettere altre letture
-    return last;
+/*
+ * stampa la tabella delle parole e delle frequenze relative su un file
+ *
+ * parametri
+ *   table: Puntatore alla tabella delle parole
+ *   file: Puntatore al file su cui scrivere
+ *   firstWord: Prima parola del testo per uso specifico nel formato di output
+ *
+ * ritorno
+ *   0 se la scrittura è riuscita, -1 altrimenti
+ */
+int print_word_table(const WordTable *table, FILE *file, const char *firstWord) {
+    (void)firstWord;
+    return print_word_rows(table, file, 0);
 }
 
+/*
+ * scrive l'intestazione del csv dei conteggi
+ * la riga "#counts,<prima>,<ultima>" distingue il formato da quello delle
+ * frequenze e conserva gli estremi del testo, collegati da una coppia in più
+ *
+ * parametri
+ *   file: file di destinazione
+ *   firstWord: prima parola del testo, può essere NULL
+ *   lastWord: ultimo token del testo, può essere NULL
+ */
+void print_counts_header(FILE *file, const char *firstWord, const char *lastWord) {
+    fprintf(file, "%s,%s,%s\n", COUNTS_HEADER, firstWord ? firstWord : "", lastWord ? lastWord : "");
+}
 
+/*
+ * stampa la tabella delle parole con i conteggi esatti delle coppie
+ * le righe hanno la stessa forma del csv delle frequenze, con interi al posto
+ * delle frequenze relative; l'intestazione va scritta prima con print_counts_header
+ *
+ * parametri
+ *   table: tabella delle parole
+ *   file: file su cui scrivere
+ *
+ * ritorno
+ *   0 se la scrittura è riuscita, -1 altrimenti, anche se era fallita l'intestazione
+ */
+int print_word_counts(const WordTable *table, FILE *file) {
+    return print_word_rows(table, file, 1);
+}
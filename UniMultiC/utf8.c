@@ -0,0 +1,236 @@
+/*
+ * gestione minima di UTF-8 per il testo italiano
+ * il decodificatore usa una tabella indicizzata dal primo byte della sequenza;
+ * la conversione tra maiuscole e minuscole copre ASCII e il supplemento Latin-1
+ * (à, è, é, ì, ò, ù e le altre lettere accentate), le cui coppie hanno la stessa
+ * lunghezza in UTF-8 e quindi possono essere convertite sul posto
+ */
+#include "utf8.h"
+#include <string.h>
+
+// classi del primo byte di una sequenza
+enum {
+    LEAD_INVALID,   // byte di continuazione, C0, C1 o oltre F4
+    LEAD_ASCII,
+    LEAD_TWO,
+    LEAD_THREE,
+    LEAD_E0,        // tre byte, secondo byte A0-BF (niente forme sovralunghe)
+    LEAD_ED,        // tre byte, secondo byte 80-9F (niente surrogati)
+    LEAD_FOUR,
+    LEAD_F0,        // quattro byte, secondo byte 90-BF
+    LEAD_F4         // quattro byte, secondo byte 80-8F (fino a U+10FFFF)
+};
+
+static const unsigned char leadClass[256] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    4, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 5, 3, 3,
+    7, 6, 6, 6, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+// per ogni classe: lunghezza, bit utili del primo byte e intervallo ammesso per il secondo byte
+static const struct {
+    unsigned char length;
+    unsigned char payload;
+    unsigned char secondMin;
+    unsigned char secondMax;
+} leadInfo[] = {
+    [LEAD_INVALID] = {1, 0x00, 0x80, 0xBF},
+    [LEAD_ASCII] = {1, 0x7F, 0x80, 0xBF},
+    [LEAD_TWO] = {2, 0x1F, 0x80, 0xBF},
+    [LEAD_THREE] = {3, 0x0F, 0x80, 0xBF},
+    [LEAD_E0] = {3, 0x0F, 0xA0, 0xBF},
+    [LEAD_ED] = {3, 0x0F, 0x80, 0x9F},
+    [LEAD_FOUR] = {4, 0x07, 0x80, 0xBF},
+    [LEAD_F0] = {4, 0x07, 0x90, 0xBF},
+    [LEAD_F4] = {4, 0x07, 0x80, 0x8F},
+};
+
+// U+00C0-U+00FF sono codificati come C3 80-BF: le tabelle convertono il secondo byte
+// le lettere maiuscole sono C3 80-9E tranne C3 97 (×); ß e ÿ restano invariate
+static const unsigned char latin1Lower[64] = {
+    0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0x97, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0x9F,
+    0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF,
+    0xB0, 0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF,
+};
+
+static const unsigned char latin1Upper[64] = {
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+    0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+    0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0xB7, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0xBF,
+};
+
+/*
+ * decodifica il carattere all'inizio del testo
+ * sequenze troncate, sovralunghe, surrogati e byte di continuazione isolati non
+ * sono validi: in quel caso si consuma un solo byte, così il chiamante può
+ * lasciarlo invariato e proseguire
+ *
+ * parametri
+ *   text: testo da decodificare
+ *   size: byte disponibili, almeno 1
+ *   codePoint: riceve il carattere, o UTF8_INVALID
+ *
+ * ritorno
+ *   il numero di byte consumati
+ */
+size_t utf8_decode(const char *text, size_t size, uint32_t *codePoint) {
+    const unsigned char *bytes = (const unsigned char *)text;
+    unsigned char lead = leadClass[bytes[0]];
+    size_t length = leadInfo[lead].length;
+
+    *codePoint = UTF8_INVALID;
+    if (lead == LEAD_INVALID || length > size) {
+        return 1;
+    }
+    if (length > 1 && (bytes[1] < leadInfo[lead].secondMin || bytes[1] > leadInfo[lead].secondMax)) {
+        return 1;
+    }
+
+    uint32_t value = bytes[0] & leadInfo[lead].payload;
+    for (size_t i = 1; i < length; i++) {
+        if ((bytes[i] & 0xC0) != 0x80) {
+            return 1;
+        }
+        value = (value << 6) | (bytes[i] & 0x3F);
+    }
+    *codePoint = value;
+    return length;
+}
+
+/*
+ * lunghezza della sequenza annunciata dal primo byte
+ * serve a chi riceve il testo un byte per volta e deve sapere quanti byte di
+ * continuazione attendere prima di decodificare con utf8_decode
+ *
+ * parametri
+ *   lead: primo byte della sequenza
+ *
+ * ritorno
+ *   da 2 a 4 per un primo byte valido, 1 per ASCII, continuazioni e byte non validi
+ */
+size_t utf8_sequence_length(unsigned char lead) {
+    return leadInfo[leadClass[lead]].length;
+}
+
+/*
+ * codifica un carattere in UTF-8
+ *
+ * parametri
+ *   codePoint: carattere da codificare, al massimo U+10FFFF
+ *   out: buffer di almeno 4 byte
+ *
+ * ritorno
+ *   il numero di byte scritti
+ */
+size_t utf8_encode(uint32_t codePoint, char *out) {
+    if (codePoint < 0x80) {
+        out[0] = (char)codePoint;
+        return 1;
+    }
+    if (codePoint < 0x800) {
+        out[0] = (char)(0xC0 | (codePoint >> 6));
+        out[1] = (char)(0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+    if (codePoint < 0x10000) {
+        out[0] = (char)(0xE0 | (codePoint >> 12));
+        out[1] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (codePoint >> 18));
+    out[1] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+/*
+ * restituisce la minuscola di un carattere ASCII o Latin-1
+ */
+uint32_t utf8_lower(uint32_t codePoint) {
+    if (codePoint >= 'A' && codePoint <= 'Z') {
+        return codePoint | 0x20;
+    }
+    if (codePoint >= 0xC0 && codePoint <= 0xFF) {
+        return 0xC0 + (latin1Lower[codePoint - 0xC0] - 0x80);
+    }
+    return codePoint;
+}
+
+/*
+ * restituisce la maiuscola di un carattere ASCII o Latin-1
+ */
+uint32_t utf8_upper(uint32_t codePoint) {
+    if (codePoint >= 'a' && codePoint <= 'z') {
+        return codePoint & ~0x20u;
+    }
+    if (codePoint >= 0xC0 && codePoint <= 0xFF) {
+        return 0xC0 + (latin1Upper[codePoint - 0xC0] - 0x80);
+    }
+    return codePoint;
+}
+
+/*
+ * indica se 16 byte consecutivi sono tutti ASCII
+ */
+static inline int is_ascii_block(const unsigned char *bytes) {
+    uint64_t low, high;
+    memcpy(&low, bytes, sizeof(low));
+    memcpy(&high, bytes + 8, sizeof(high));
+    return ((low | high) & 0x8080808080808080ULL) == 0;
+}
+
+/*
+ * converte in minuscolo un testo UTF-8 sul posto
+ * i blocchi di 16 byte senza bit alti seguono il percorso ASCII; il resto viene
+ * decodificato sequenza per sequenza e solo le lettere C3 xx vengono convertite.
+ * Le sequenze non valide restano invariate
+ *
+ * parametri
+ *   text: testo da convertire
+ *   length: numero di byte
+ */
+void utf8_fold(char *text, size_t length) {
+    unsigned char *bytes = (unsigned char *)text;
+    size_t i = 0;
+    while (i < length) {
+        if (length - i >= 16 && is_ascii_block(bytes + i)) {
+            for (size_t end = i + 16; i < end; i++) {
+                if ((unsigned char)(bytes[i] - 'A') < 26) {
+                    bytes[i] |= 0x20;
+                }
+            }
+            continue;
+        }
+        if (bytes[i] < 0x80) {
+            if ((unsigned char)(bytes[i] - 'A') < 26) {
+                bytes[i] |= 0x20;
+            }
+            i++;
+            continue;
+        }
+
+        uint32_t codePoint;
+        size_t sequence = utf8_decode(text + i, length - i, &codePoint);
+        if (bytes[i] == 0xC3 && sequence == 2) {
+            bytes[i + 1] = latin1Lower[bytes[i + 1] - 0x80];
+        }
+        i += sequence;
+    }
+}
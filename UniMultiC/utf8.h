@@ -0,0 +1,27 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define UTF8_INVALID 0xFFFFFFFFu // sequenza non valida: il byte viene lasciato com'è
+
+// decodifica il carattere all'inizio di text; ritorna i byte consumati (1 per una sequenza non valida)
+size_t utf8_decode(const char *text, size_t size, uint32_t *codePoint);
+
+// lunghezza della sequenza che inizia con il byte lead; 1 per ASCII e per i byte che non iniziano una sequenza
+size_t utf8_sequence_length(unsigned char lead);
+
+// codifica un carattere in out (almeno 4 byte); ritorna il numero di byte scritti
+size_t utf8_encode(uint32_t codePoint, char *out);
+
+// minuscola di un carattere ASCII o del supplemento Latin-1, altrimenti il carattere stesso
+uint32_t utf8_lower(uint32_t codePoint);
+
+// maiuscola di un carattere ASCII o del supplemento Latin-1, altrimenti il carattere stesso
+uint32_t utf8_upper(uint32_t codePoint);
+
+// converte in minuscolo length byte di testo UTF-8 sul posto; la lunghezza non cambia
+void utf8_fold(char *text, size_t length);
+
+#endif // UTF8_H